@@ -0,0 +1,134 @@
+//Author: Sivert Andresen Cubedo
+
+#include "FrameScheduler.hpp"
+
+#include <algorithm>
+
+FrameScheduler::FrameScheduler(double target_rate) :
+	m_period(Clock::duration::zero()),
+	m_next_frame_time(Clock::now()),
+	m_frame_begin(m_next_frame_time),
+	m_last_frame_end(m_next_frame_time)
+{
+	setTargetRate(target_rate);
+}
+
+void FrameScheduler::setTargetRate(double rate) {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	if (rate > 0.0) {
+		m_period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+	}
+	else {
+		m_period = Clock::duration::zero();
+	}
+	m_condition.notify_all();
+}
+
+void FrameScheduler::setVsync(bool v) {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	m_vsync = v;
+	m_condition.notify_all();
+}
+
+bool FrameScheduler::getVsync() {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	return m_vsync;
+}
+
+void FrameScheduler::setOnDemand(bool v) {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	m_on_demand = v;
+	m_frame_requested = true;
+	m_condition.notify_all();
+}
+
+void FrameScheduler::requestFrame() {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	m_frame_requested = true;
+	m_condition.notify_all();
+}
+
+void FrameScheduler::wake() {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	m_wake = true;
+	m_condition.notify_all();
+}
+
+bool FrameScheduler::frameDue(Clock::time_point now) {
+	if (m_on_demand && !m_frame_requested) {
+		return false;
+	}
+	return m_vsync || now >= m_next_frame_time;
+}
+
+bool FrameScheduler::wait(Clock::duration poll_interval) {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	Clock::time_point now = Clock::now();
+	Clock::time_point poll_time = now + poll_interval;
+	while (!frameDue(now) && !m_wake) {
+		//sleep until the deadline if a frame is wanted, else until woken or poll_time
+		Clock::time_point until = poll_time;
+		if (!m_on_demand || m_frame_requested) {
+			until = std::min(until, m_next_frame_time);
+		}
+		if (now >= poll_time) {
+			break;
+		}
+		m_condition.wait_until(m_lock, until);
+		now = Clock::now();
+	}
+	m_wake = false;
+	return frameDue(now);
+}
+
+void FrameScheduler::beginFrame() {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	m_frame_begin = Clock::now();
+	m_frame_requested = false;
+	//after an idle period the schedule starts over from now
+	if (m_frame_begin - m_next_frame_time > m_period) {
+		m_next_frame_time = m_frame_begin;
+		m_last_frame_end = m_frame_begin;
+	}
+}
+
+void FrameScheduler::endFrame() {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	Clock::time_point now = Clock::now();
+	++m_stats.frame_count;
+	m_stats.last_frame_ms = std::chrono::duration<double, std::milli>(now - m_frame_begin).count();
+	m_stats.last_interval_ms = std::chrono::duration<double, std::milli>(now - m_last_frame_end).count();
+	if (m_period > Clock::duration::zero()) {
+		if (m_vsync) {
+			//display waited for a refresh, more than one and a half periods means a refresh was missed
+			Clock::duration interval = now - m_last_frame_end;
+			if (interval * 2 > m_period * 3) {
+				++m_stats.missed_deadline_count;
+				m_stats.skipped_period_count += static_cast<std::uint64_t>((interval + m_period / 2) / m_period) - 1;
+			}
+			m_next_frame_time = now;
+		}
+		else {
+			Clock::time_point deadline = m_next_frame_time + m_period;
+			m_next_frame_time = deadline;
+			if (now > deadline) {
+				++m_stats.missed_deadline_count;
+				//start the next frame on the next whole period instead of rushing to catch up
+				Clock::duration behind = now - deadline;
+				std::uint64_t skip = static_cast<std::uint64_t>(behind / m_period) + 1;
+				m_next_frame_time += m_period * static_cast<Clock::rep>(skip);
+				m_stats.skipped_period_count += skip;
+			}
+		}
+	}
+	else {
+		m_next_frame_time = now;
+	}
+	m_last_frame_end = now;
+}
+
+FrameScheduler::Stats FrameScheduler::getStats() {
+	std::unique_lock<std::mutex> m_lock(m_mutex);
+	return m_stats;
+}
+
@@ -0,0 +1,108 @@
+//Author: Sivert Andresen Cubedo
+#pragma once
+
+#ifndef FrameScheduler_HEADER
+#define FrameScheduler_HEADER
+
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+/*
+Paces frames of a window thread against steady_clock deadlines
+Deadlines advance by a whole period each frame, so sleep error does not add up
+All functions are thread safe
+*/
+class FrameScheduler {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Stats {
+		std::uint64_t frame_count = 0;
+		std::uint64_t missed_deadline_count = 0;	//frames that finished after their deadline
+		std::uint64_t skipped_period_count = 0;		//whole periods dropped to catch up after missed deadlines
+		double last_frame_ms = 0.0;					//beginFrame to endFrame
+		double last_interval_ms = 0.0;				//endFrame to endFrame
+	};
+
+	/*
+	Constructor
+	*/
+	FrameScheduler(double target_rate = 60.0);
+
+	/*
+	Set target rate in frames per second
+	Zero or less renders as fast as possible
+	*/
+	void setTargetRate(double rate);
+
+	/*
+	Set vsync
+	If true, display blocks until the next refresh, so wait does not sleep for deadlines
+	The target rate should then be the refresh rate, a frame taking more than one refresh counts as missed
+	*/
+	void setVsync(bool v);
+	bool getVsync();
+
+	/*
+	Set render on demand
+	If true, wait only reports a frame after requestFrame
+	*/
+	void setOnDemand(bool v);
+
+	/*
+	Ask for a frame in on demand mode
+	Wakes a thread blocked in wait
+	*/
+	void requestFrame();
+
+	/*
+	Wake a thread blocked in wait without asking for a frame
+	*/
+	void wake();
+
+	/*
+	Block until the next frame is due, but at most poll_interval so input can be polled
+	return:
+		true if a frame is due
+	*/
+	bool wait(Clock::duration poll_interval);
+
+	/*
+	Call before rendering a frame
+	*/
+	void beginFrame();
+
+	/*
+	Call after display
+	Advances the deadline and counts it as missed if it has passed
+	*/
+	void endFrame();
+
+	/*
+	Get stats
+	*/
+	Stats getStats();
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	Clock::duration m_period;
+	bool m_vsync = false;
+	bool m_on_demand = false;
+	bool m_frame_requested = true;
+	bool m_wake = false;
+	Clock::time_point m_next_frame_time;		//earliest start of next frame
+	Clock::time_point m_frame_begin;
+	Clock::time_point m_last_frame_end;
+	Stats m_stats;
+
+	/*
+	Check if a frame is due, m_mutex must be held
+	*/
+	bool frameDue(Clock::time_point now);
+};
+
+#endif // !FrameScheduler_HEADER
+
@@ -2,7 +2,8 @@
 
 Window::Window(sf::VideoMode mode, const std::string & title, sf::Uint32 style, const sf::ContextSettings & settings) :
 	m_running(true),
-	m_sleep_duration(16),
+	m_frame_scheduler(60.0),
+	m_input_poll_interval(10),
 	m_thread(&Window::windowHandler, this, mode, title, style, settings)
 {
 }
@@ -15,6 +16,27 @@ void Window::join() {
 
 void Window::close() {
 	m_running = false;
+	m_frame_scheduler.wake();
+}
+
+void Window::setTargetRate(double rate) {
+	m_frame_scheduler.setTargetRate(rate);
+}
+
+void Window::setVsync(bool v) {
+	m_frame_scheduler.setVsync(v);
+}
+
+void Window::setRenderOnDemand(bool v) {
+	m_frame_scheduler.setOnDemand(v);
+}
+
+void Window::requestFrame() {
+	m_frame_scheduler.requestFrame();
+}
+
+FrameScheduler::Stats Window::getFrameStats() {
+	return m_frame_scheduler.getStats();
 }
 
 void Window::windowHandler(sf::VideoMode mode, const std::string & title, sf::Uint32 style, const sf::ContextSettings & settings) {
@@ -24,18 +46,30 @@ void Window::windowHandler(sf::VideoMode mode, const std::string & title, sf::Ui
 
 	//loop
 	sf::Clock delta_clock;
+	bool vsync = false;
 	while (m_running) {
-		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
-		sf::Time dt = delta_clock.restart();
-		
+		//sleeps until the next deadline, waking up to poll input in between
+		bool frame_due = m_frame_scheduler.wait(m_input_poll_interval);
+
 		eventHandler(window);
 
+		if (!frame_due || !m_running) {
+			continue;
+		}
+
+		if (m_frame_scheduler.getVsync() != vsync) {
+			vsync = !vsync;
+			window.setVerticalSyncEnabled(vsync);
+		}
+
+		m_frame_scheduler.beginFrame();
+		sf::Time dt = delta_clock.restart();
+
 		updateHandler(window, dt);
 
 		drawHandler(window, dt);
 
-		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-		std::this_thread::sleep_for(m_sleep_duration - std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+		m_frame_scheduler.endFrame();
 	}
 	//close
 	window.close();
@@ -76,6 +110,8 @@ void Window::loadHandler(sf::RenderWindow & window) {
 void Window::eventHandler(sf::RenderWindow & window) {
 	sf::Event e;
 	while (window.pollEvent(e)) {
+		//any input may change what is drawn
+		m_frame_scheduler.requestFrame();
 		switch (e.type) {
 		case sf::Event::Closed:
 			m_running = false;
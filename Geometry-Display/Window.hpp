@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <thread>
+#include <atomic>
 #include <memory>
 #include <functional>
 
@@ -13,6 +14,7 @@
 
 #include "PushButton.hpp"
 #include "ToggleButton.hpp"
+#include "FrameScheduler.hpp"
 
 class Window {
 public:
@@ -31,11 +33,38 @@ public:
 	*/
 	void close();
 
+	/*
+	Set target frame rate, zero or less is unlimited
+	*/
+	void setTargetRate(double rate);
+
+	/*
+	Set vsync, target rate should then be the refresh rate
+	*/
+	void setVsync(bool v);
+
+	/*
+	Set render on demand
+	If true, frames are only rendered after input or requestFrame
+	*/
+	void setRenderOnDemand(bool v);
+
+	/*
+	Ask for a frame in render on demand mode
+	*/
+	void requestFrame();
+
+	/*
+	Get frame count and missed deadlines
+	*/
+	FrameScheduler::Stats getFrameStats();
+
 private:
-	std::thread m_thread;
-	bool m_running;
-	std::chrono::milliseconds m_sleep_duration;
+	std::atomic<bool> m_running;
+	FrameScheduler m_frame_scheduler;
+	std::chrono::milliseconds m_input_poll_interval;
 	std::vector<std::unique_ptr<GUI::GUIBase>> m_gui_object_vec;
+	std::thread m_thread;		//last, so everything above is initialized before the thread starts
 
 	/*
 	Function for window thread
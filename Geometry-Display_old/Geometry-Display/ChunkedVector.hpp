@@ -0,0 +1,124 @@
+//Author: Sivert Andresen Cubedo
+#pragma once
+
+#ifndef ChunkedVector_HEADER
+#define ChunkedVector_HEADER
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+namespace GeometryDisplay {
+	/*
+	Vector stored as fixed size chunks shared between copies
+	Copying only copies the chunk pointers, a chunk is copied the first time it is written while another copy holds it
+	One thread may write a ChunkedVector, any number of threads may read copies of it
+	*/
+	template <typename T, std::size_t ChunkSize = 4096>
+	class ChunkedVector {
+	private:
+		static_assert((ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize must be a power of two");
+
+		std::vector<std::shared_ptr<std::vector<T>>> m_chunk_vec;
+		std::size_t m_size = 0;
+
+		/*
+		Get chunk for writing, copying it if it is shared
+		*/
+		std::vector<T> & writableChunk(std::size_t chunk) {
+			std::shared_ptr<std::vector<T>> & ptr = m_chunk_vec[chunk];
+			if (ptr.use_count() > 1) {
+				std::shared_ptr<std::vector<T>> copy = std::make_shared<std::vector<T>>();
+				copy->reserve(ChunkSize);
+				copy->assign(ptr->begin(), ptr->end());
+				ptr = std::move(copy);
+			}
+			else {
+				//pairs with the release of the last other copy dropping its reference
+				std::atomic_thread_fence(std::memory_order_acquire);
+			}
+			return *ptr;
+		}
+
+	public:
+		static const std::size_t chunk_size = ChunkSize;
+
+		/*
+		Number of elements
+		*/
+		std::size_t size() const {
+			return m_size;
+		}
+
+		bool empty() const {
+			return m_size == 0;
+		}
+
+		const T & operator[](std::size_t i) const {
+			return (*m_chunk_vec[i / ChunkSize])[i % ChunkSize];
+		}
+
+		const T & back() const {
+			return (*this)[m_size - 1];
+		}
+
+		/*
+		Set element i
+		Copies its chunk if shared
+		*/
+		void set(std::size_t i, T value) {
+			writableChunk(i / ChunkSize)[i % ChunkSize] = std::move(value);
+		}
+
+		void push_back(T value) {
+			if (m_size % ChunkSize == 0) {
+				m_chunk_vec.push_back(std::make_shared<std::vector<T>>());
+				m_chunk_vec.back()->reserve(ChunkSize);
+			}
+			writableChunk(m_chunk_vec.size() - 1).push_back(std::move(value));
+			++m_size;
+		}
+
+		/*
+		Shrink to count elements
+		Does nothing if count is not smaller than size
+		*/
+		void truncate(std::size_t count) {
+			if (count >= m_size) {
+				return;
+			}
+			m_chunk_vec.resize((count + ChunkSize - 1) / ChunkSize);
+			if (count % ChunkSize != 0) {
+				writableChunk(m_chunk_vec.size() - 1).resize(count % ChunkSize);
+			}
+			m_size = count;
+		}
+
+		void clear() {
+			m_chunk_vec.clear();
+			m_size = 0;
+		}
+
+		/*
+		Copy elements to a plain vector
+		*/
+		std::vector<T> toVector() const {
+			std::vector<T> out_vec;
+			out_vec.reserve(m_size);
+			for (const std::shared_ptr<std::vector<T>> & chunk : m_chunk_vec) {
+				out_vec.insert(out_vec.end(), chunk->begin(), chunk->end());
+			}
+			return out_vec;
+		}
+	};
+
+	template <typename T, std::size_t ChunkSize>
+	const std::size_t ChunkedVector<T, ChunkSize>::chunk_size;
+}
+
+#endif // !ChunkedVector_HEADER
+
+
+//end
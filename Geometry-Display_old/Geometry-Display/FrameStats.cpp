@@ -0,0 +1,113 @@
+//Author: Sivert Andresen Cubedo
+
+#include "FrameStats.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+using namespace GeometryDisplay;
+
+const std::size_t FrameStatsRecorder::max_sample_count;
+
+const char* FrameStats::getPhaseName(Phase phase) {
+	switch (phase) {
+	case Events:
+		return "events";
+	case Scene:
+		return "scene";
+	case UI:
+		return "ui";
+	case Lines:
+		return "lines";
+	case Tessellate:
+		return "tessellate";
+	case Draw:
+		return "draw";
+	case Labels:
+		return "labels";
+	case Display:
+		return "display";
+	case Total:
+		return "total";
+	case Prepare:
+		return "prepare";
+	default:
+		return "";
+	}
+}
+
+std::string FrameStats::toString() const {
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(2);
+	stream << "frame " << frame_count << ", ms over " << sample_count << " frames\n";
+	stream << std::left << std::setw(11) << "phase" << std::right << std::setw(7) << "last" << std::setw(7) << "p50" << std::setw(7) << "p95" << std::setw(7) << "p99" << std::setw(7) << "max" << "\n";
+	for (std::size_t i = 0; i < phase_time_arr.size(); ++i) {
+		const PhaseTime & t = phase_time_arr[i];
+		stream << std::left << std::setw(11) << getPhaseName(static_cast<Phase>(i)) << std::right;
+		stream << std::setw(7) << t.last << std::setw(7) << t.p50 << std::setw(7) << t.p95 << std::setw(7) << t.p99 << std::setw(7) << t.max << "\n";
+	}
+	stream << "shapes " << drawn_shape_count << " drawn, " << culled_shape_count << " culled, " << shape_count << " total\n";
+	stream << "vertices " << vertex_count << ", triangles " << triangle_count << ", labels " << label_count;
+	return stream.str();
+}
+
+void FrameStatsRecorder::add(FrameStats::Phase phase, float ms) {
+	m_current_time_arr[phase] += ms;
+}
+
+FrameStatsRecorder::Clock::time_point FrameStatsRecorder::add(FrameStats::Phase phase, Clock::time_point begin) {
+	Clock::time_point now = Clock::now();
+	add(phase, std::chrono::duration<float, std::milli>(now - begin).count());
+	return now;
+}
+
+void FrameStatsRecorder::endFrame() {
+	float total = 0.f;
+	for (std::size_t i = 0; i < FrameStats::Total; ++i) {
+		total += m_current_time_arr[i];
+	}
+	m_current_time_arr[FrameStats::Total] = total;
+	m_sample_arr[m_next_sample] = m_current_time_arr;
+	m_next_sample = (m_next_sample + 1) % max_sample_count;
+	m_sample_count = std::min(m_sample_count + 1, max_sample_count);
+
+	m_last = current;
+	m_last.frame_count = current.frame_count + 1;
+	for (std::size_t i = 0; i < FrameStats::PhaseCount; ++i) {
+		m_last.phase_time_arr[i].last = m_current_time_arr[i];
+	}
+	current = FrameStats();
+	current.frame_count = m_last.frame_count;
+	m_current_time_arr.fill(0.f);
+}
+
+FrameStats FrameStatsRecorder::getStats() const {
+	FrameStats stats = m_last;
+	stats.sample_count = m_sample_count;
+	if (m_sample_count == 0) {
+		return stats;
+	}
+	std::vector<float> time_vec(m_sample_count);
+	for (std::size_t phase = 0; phase < FrameStats::PhaseCount; ++phase) {
+		for (std::size_t i = 0; i < m_sample_count; ++i) {
+			time_vec[i] = m_sample_arr[i][phase];
+		}
+		std::sort(time_vec.begin(), time_vec.end());
+		//nearest rank
+		auto percentile = [&](float p) {
+			std::size_t rank = static_cast<std::size_t>(p * static_cast<float>(m_sample_count - 1) + 0.5f);
+			return time_vec[rank];
+		};
+		FrameStats::PhaseTime & t = stats.phase_time_arr[phase];
+		t.p50 = percentile(0.50f);
+		t.p95 = percentile(0.95f);
+		t.p99 = percentile(0.99f);
+		t.max = time_vec.back();
+	}
+	return stats;
+}
+
+
+//end
@@ -0,0 +1,110 @@
+//Author: Sivert Andresen Cubedo
+#pragma once
+
+#ifndef FrameStats_HEADER
+#define FrameStats_HEADER
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace GeometryDisplay {
+	/*
+	Timings and counts of recent frames
+	Times are in milliseconds
+	*/
+	struct FrameStats {
+		enum Phase {
+			Events,				//handling input
+			Scene,				//applying queued scene commands and taking the frame from prep_thread
+			UI,					//borders, buttons and overlays
+			Lines,				//diagram lines
+			Tessellate,			//copying prepared vertices into tiles
+			Draw,				//submitting shape vertices
+			Labels,				//placing and drawing names
+			Display,			//window.display
+			Total,
+			Prepare,			//tessellating on prep_thread, overlaps the other phases so it is not part of Total
+			PhaseCount
+		};
+
+		struct PhaseTime {
+			float last = 0.f;
+			float p50 = 0.f;
+			float p95 = 0.f;
+			float p99 = 0.f;
+			float max = 0.f;
+		};
+
+		std::array<PhaseTime, PhaseCount> phase_time_arr;
+		std::uint64_t frame_count = 0;
+		std::size_t sample_count = 0;		//frames the percentiles are taken over
+
+		//last frame
+		std::size_t vertex_count = 0;
+		std::size_t triangle_count = 0;
+		std::size_t shape_count = 0;
+		std::size_t drawn_shape_count = 0;
+		std::size_t culled_shape_count = 0;
+		std::size_t label_count = 0;
+
+		/*
+		Get name of phase
+		*/
+		static const char* getPhaseName(Phase phase);
+
+		/*
+		Make multi line summary
+		*/
+		std::string toString() const;
+	};
+
+	/*
+	Collects FrameStats over the last frames
+	*/
+	class FrameStatsRecorder {
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		//counts of the frame being recorded
+		FrameStats current;
+
+		/*
+		Add time to phase of current frame
+		*/
+		void add(FrameStats::Phase phase, float ms);
+
+		/*
+		Add time since begin to phase of current frame
+		return:
+			current time, to time the next phase from
+		*/
+		Clock::time_point add(FrameStats::Phase phase, Clock::time_point begin);
+
+		/*
+		Finish current frame and start a new one
+		*/
+		void endFrame();
+
+		/*
+		Get stats with percentiles over recorded frames
+		*/
+		FrameStats getStats() const;
+
+	private:
+		static const std::size_t max_sample_count = 128;
+
+		std::array<float, FrameStats::PhaseCount> m_current_time_arr = {};
+		std::array<std::array<float, FrameStats::PhaseCount>, max_sample_count> m_sample_arr;
+		std::size_t m_next_sample = 0;
+		std::size_t m_sample_count = 0;
+		FrameStats m_last;
+	};
+}
+
+#endif // !FrameStats_HEADER
+
+
+//end
@@ -2,6 +2,15 @@
 
 #include "GeometryDisplay.hpp"
 
+#include <cerrno>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
 using namespace GeometryDisplay;
 
 std::vector<wykobi::triangle<float, 2>> GeometryDisplay::makeTrianglePoint(float x, float y, float radius, std::size_t point_count) {
@@ -263,6 +272,8 @@ void ToggleButton::draw(sf::RenderTarget & target, sf::RenderStates states) cons
 	target.draw(text, states);
 }
 
+const unsigned int Window::max_diagram_line_count;
+
 Window::Window() :
 	m_polygon_shape_maker(screen_view, world_view)
 {
@@ -353,12 +364,22 @@ void Window::create() {
 	auto_size_button.click_color = { 91, 105, 233 };
 	auto_size_button.push_function = std::bind(&Window::buttonFunc_auto_size, this);
 
+	//init frame stats button
+	frame_stats_button.setFont(text_font);
+	frame_stats_button.not_toggle_text = "Stats";
+	frame_stats_button.toggle_text = "Stats";
+	frame_stats_button.setArea(sf::IntRect(0, 0, 30, 30));
+	frame_stats_button.positionRight(auto_size_button);
+	frame_stats_button.not_toggle_color = { 204, 204, 204 };
+	frame_stats_button.toggle_color = { 91, 105, 233 };
+	frame_stats_button.toggle_function = std::bind(&Window::buttonFunc_frame_stats, this, std::placeholders::_1);
+
 	//init make polygon button
 	make_polygon_button.setFont(text_font);
 	make_polygon_button.not_click_text = "Make\nPoly";
 	make_polygon_button.click_text = "Make\nPoly";
 	make_polygon_button.setArea(sf::IntRect(0, 0, 30, 30));
-	make_polygon_button.positionRight(auto_size_button);
+	make_polygon_button.positionRight(frame_stats_button);
 	make_polygon_button.not_click_color = { 204, 204, 204 };
 	make_polygon_button.click_color = { 91, 105, 233 };
 	make_polygon_button.push_function = std::bind(&Window::buttonFunc_make_polygon, this);
@@ -372,10 +393,30 @@ void Window::create() {
 	make_line_button.not_click_color = { 204, 204, 204 };
 	make_line_button.click_color = { 91, 105, 233 };
 
+	//init select button
+	select_button.setFont(text_font);
+	select_button.not_toggle_text = "Select";
+	select_button.toggle_text = "Select";
+	select_button.setArea(sf::IntRect(0, 0, 30, 30));
+	select_button.positionRight(make_polygon_button);
+	select_button.not_toggle_color = { 204, 204, 204 };
+	select_button.toggle_color = { 91, 105, 233 };
+	select_button.toggle_function = std::bind(&Window::buttonFunc_select, this, std::placeholders::_1);
+
+	//init save selection button
+	save_selection_button.setFont(text_font);
+	save_selection_button.not_click_text = "Save\nSel";
+	save_selection_button.click_text = "Save\nSel";
+	save_selection_button.setArea(sf::IntRect(0, 0, 30, 30));
+	save_selection_button.positionRight(select_button);
+	save_selection_button.not_click_color = { 204, 204, 204 };
+	save_selection_button.click_color = { 91, 105, 233 };
+	save_selection_button.push_function = std::bind(&Window::buttonFunc_save_selection, this);
+
 	//start window_thread
 	window_thread = std::thread(&Window::windowHandler, this);
 
-	update_frame = true;
+	requestFrame(InvalidateView | InvalidateScene | InvalidateUI);
 }
 
 void Window::create(sf::Vector2u win_size) {
@@ -384,34 +425,35 @@ void Window::create(sf::Vector2u win_size) {
 }
 
 void Window::buttonFunc_clear_draw_object() {
-	draw_object_vec_mutex.lock();
-	draw_object_vec.clear();
-	draw_object_vec_mutex.unlock();
-	update_frame = true;
+	clearShapeVec();
 }
 void Window::buttonFunc_load_draw_object() {
 	loadShapeFromFile();
-	update_frame = true;
+	invalidate(InvalidateUI);
 }
 void Window::buttonFunc_save_draw_object() {
 	saveShapeToFile();
-	update_frame = true;
+	invalidate(InvalidateUI);
 }
 void Window::buttonFunc_show_draw_object_name(bool t) {
 	show_draw_object_name = t;
-	update_frame = true;
+	invalidate(InvalidateScene);
 }
 void Window::buttonFunc_lock_world_view_scale(bool t) {
 	lock_world_view_scale = t;
-	update_frame = true;
+	invalidate(InvalidateUI);
 }
 void Window::buttonFunc_mouse_move(bool t) {
 	mouse_move = t;
-	update_frame = true;
+	invalidate(InvalidateUI);
 }
 void Window::buttonFunc_auto_size() {
 	autoSize();
-	update_frame = true;
+	invalidate(InvalidateView);
+}
+void Window::buttonFunc_frame_stats(bool t) {
+	show_frame_stats = t;
+	invalidate(InvalidateUI);
 }
 void Window::buttonFunc_make_polygon() {
 	if (!m_make_polygon_mode) {
@@ -425,6 +467,15 @@ void Window::buttonFunc_make_polygon() {
 		}
 	}
 }
+void Window::buttonFunc_select(bool t) {
+	select_mode = t;
+	select_drag = false;
+	invalidate(InvalidateUI);
+}
+void Window::buttonFunc_save_selection() {
+	saveSelectionToFile();
+	invalidate(InvalidateUI);
+}
 
 void Window::windowHandler() {
 	window_mutex.lock();
@@ -435,11 +486,17 @@ void Window::windowHandler() {
 	setViewPositionCorner(world_view, { 0.f, 0.f }, 0);
 	window_mutex.unlock();
 
+	prep_thread = std::thread(&Window::prepHandler, this);
+
+	std::chrono::steady_clock::time_point last_input_time = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point last_render_time = last_input_time - std::chrono::milliseconds(update_interval);
 	while (running) {
 		window_mutex.lock();
+		FrameStatsRecorder::Clock::time_point phase_begin = FrameStatsRecorder::Clock::now();
 		//check input
 		sf::Event e;
 		while (window.pollEvent(e)) {
+			last_input_time = std::chrono::steady_clock::now();
 			switch (e.type) {
 			case sf::Event::Closed:
 				running = false;
@@ -447,35 +504,35 @@ void Window::windowHandler() {
 			case sf::Event::Resized:
 				window_size = { e.size.width, e.size.height };
 				screen_view = sf::View(sf::FloatRect(0.f, 0.f, static_cast<float>(window_size.x), static_cast<float>(window_size.y)));
-				update_frame = true;
+				ui_texture_dirty = true;
+				invalidate(InvalidateView | InvalidateUI);
 				break;
 			case sf::Event::MouseWheelScrolled:
+				//zoom steps multiply, applied once at the last scroll position
 				if (mouse_move) {
 					if (e.mouseWheelScroll.delta > 0.f) {
-						zoomViewAtPixel({ e.mouseWheelScroll.x, e.mouseWheelScroll.y }, world_view, window, 1.f / mouse_zoom_amount);
+						input_zoom /= mouse_zoom_amount;
 					}
 					else if (e.mouseWheelScroll.delta < 0.f) {
-						zoomViewAtPixel({ e.mouseWheelScroll.x, e.mouseWheelScroll.y }, world_view, window, mouse_zoom_amount);
+						input_zoom *= mouse_zoom_amount;
 					}
-					update_frame = true;
+					input_zoom_pixel = { e.mouseWheelScroll.x, e.mouseWheelScroll.y };
 				}
 				break;
 			case sf::Event::MouseMoved:
+				//only the last position matters, handled once after the events are polled
 				mouse_pos = { e.mouseMove.x, e.mouseMove.y };
-				if (mouse_move) {
-					if (mouse_left_bounce) {
-						mouse_current_pos = window.mapPixelToCoords(mouse_pos, world_view);
-						sf::Vector2f m = mouse_start_pos - mouse_current_pos;
-						world_view.move(m);
-					}
-					update_frame = true;
-				}
+				input_mouse_moved = true;
 				break;
 			case sf::Event::MouseButtonPressed:
+				//buttons act on the view and position before them
+				applyCoalescedInput();
 				mouse_pos = { e.mouseButton.x, e.mouseButton.y };				
 				switch (e.mouseButton.button)
 				{
 				case sf::Mouse::Left:
+					//any button may change state
+					ui_texture_dirty = true;
 					clear_draw_object_vec_button.click(mouse_pos);
 					load_draw_object_button.click(mouse_pos);
 					save_draw_object_button.click(mouse_pos);
@@ -483,9 +540,20 @@ void Window::windowHandler() {
 					show_draw_object_name_button.click(mouse_pos);
 					lock_world_view_scale_button.click(mouse_pos);
 					auto_size_button.click(mouse_pos);
+					frame_stats_button.click(mouse_pos);
 					make_polygon_button.click(mouse_pos);
+					select_button.click(mouse_pos);
+					save_selection_button.click(mouse_pos);
 					mouse_left_down = true;
-					if (mouse_move) {
+					if (select_mode) {
+						if (diagram_area.contains(static_cast<float>(mouse_pos.x), static_cast<float>(mouse_pos.y))) {
+							select_start_pos = window.mapPixelToCoords(mouse_pos, world_view);
+							select_current_pos = select_start_pos;
+							select_drag = true;
+							hover_shape_id = null_shape_id;
+						}
+					}
+					else if (mouse_move) {
 						if (diagram_area.contains(static_cast<float>(mouse_pos.x), static_cast<float>(mouse_pos.y))) {
 							if (!mouse_left_bounce) {
 								mouse_start_pos = window.mapPixelToCoords(mouse_pos, world_view);
@@ -497,7 +565,12 @@ void Window::windowHandler() {
 				case sf::Mouse::Right:
 
 					if (m_make_polygon_mode) {
-						bool v = m_polygon_shape_maker.addPoint(window.mapPixelToCoords(mouse_pos, world_view));
+						sf::Vector2f point;
+						if (!snapPixel(mouse_pos, point)) {
+							point = window.mapPixelToCoords(mouse_pos, world_view);
+						}
+						bool v = m_polygon_shape_maker.addPoint(point);
+						invalidate(InvalidateUI);
 
 					}
 
@@ -508,9 +581,11 @@ void Window::windowHandler() {
 				}
 				break;
 			case sf::Event::MouseButtonReleased:
+				applyCoalescedInput();
 				mouse_pos = { e.mouseButton.x, e.mouseButton.y };
 				mouse_left_down = false;
 				mouse_left_bounce = false;
+				ui_texture_dirty = true;
 				clear_draw_object_vec_button.release();
 				load_draw_object_button.release();
 				save_draw_object_button.release();
@@ -518,15 +593,59 @@ void Window::windowHandler() {
 				show_draw_object_name_button.release();
 				lock_world_view_scale_button.release();
 				auto_size_button.release();
+				frame_stats_button.release();
 				make_polygon_button.release();
-				update_frame = true;
+				select_button.release();
+				save_selection_button.release();
+				if (select_drag && e.mouseButton.button == sf::Mouse::Left) {
+					select_current_pos = window.mapPixelToCoords(mouse_pos, world_view);
+					select_drag = false;
+					selected_id_vec.clear();
+					wykobi::rectangle<float> rect = SpatialIndex::normalizeRectangle(wykobi::make_rectangle(select_start_pos.x, select_start_pos.y, select_current_pos.x, select_current_pos.y));
+					queryDrawObject(makeRectanglePolygon(rect), selected_id_vec);
+				}
+				invalidate(InvalidateUI);
 				break;
 			default:
 				break;
 			}
 		}
 
-		if (update_frame) {
+		applyCoalescedInput();
+		phase_begin = frame_stats_recorder.add(FrameStats::Events, phase_begin);
+
+		//shapes show up once prep_thread has tessellated them
+		applySceneCommands();
+		if (takePreparedFrame()) {
+			invalidate(InvalidateScene);
+		}
+
+		if (m_make_polygon_mode) {
+			updateSnapTree();
+		}
+		phase_begin = frame_stats_recorder.add(FrameStats::Scene, phase_begin);
+
+		//render only when something changed, at most once per update_interval
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::chrono::milliseconds frame_interval(update_interval);
+		if (invalidation == InvalidateOverlay && overlay_base_valid && now - last_render_time >= frame_interval) {
+			//only the tooltip moved, draw it over the last full frame
+			last_render_time = now;
+			invalidation.exchange(0);
+			window.clear(window_background_color);
+			window.setView(screen_view);
+			window.draw(sf::Sprite(overlay_base_texture));
+			renderHoverInfo();
+			if (show_frame_stats) {
+				renderFrameStats();
+			}
+			window.display();
+			frame_stats_recorder.add(FrameStats::Display, phase_begin);
+			frame_stats_recorder.endFrame();
+		}
+		else if (invalidation != 0 && now - last_render_time >= frame_interval) {
+			last_render_time = now;
+			unsigned int frame_invalidation = invalidation.exchange(0);
 			window.clear(window_background_color);
 
 			window.setTitle(window_title);
@@ -540,40 +659,179 @@ void Window::windowHandler() {
 			}
 
 			renderUI();
+			phase_begin = frame_stats_recorder.add(FrameStats::UI, phase_begin);
 
-			renderLines();
+			renderLines((frame_invalidation & InvalidateView) != 0);
+			phase_begin = frame_stats_recorder.add(FrameStats::Lines, phase_begin);
 			
-			renderDrawObject();
+			renderDrawObject((frame_invalidation & (InvalidateView | InvalidateScene)) != 0);
+			phase_begin = FrameStatsRecorder::Clock::now();
+
+			renderSelection();
+
+			if (m_make_polygon_mode && snap_point_valid) {
+				renderSnapPoint();
+			}
 
 			window.setView(screen_view);
 
-			window.draw(clear_draw_object_vec_button);
-			window.draw(load_draw_object_button);
-			window.draw(save_draw_object_button);
-			window.draw(mouse_move_button);
-			window.draw(show_draw_object_name_button);
-			window.draw(lock_world_view_scale_button);
-			window.draw(auto_size_button);
-			window.draw(make_polygon_button);
+			overlay_base_valid = false;
+			if (hover_shape_id != null_shape_id) {
+				//keep the frame so moving the tooltip does not redraw the scene
+				sf::Vector2u size = window.getSize();
+				if (overlay_base_texture.getSize() != size) {
+					overlay_base_texture.create(size.x, size.y);
+				}
+				overlay_base_texture.update(window);
+				overlay_base_valid = true;
+				renderHoverInfo();
+			}
+
+			if (show_frame_stats) {
+				renderFrameStats();
+			}
+			phase_begin = frame_stats_recorder.add(FrameStats::UI, phase_begin);
 
 			window.display();
-			update_frame = false;
+			frame_stats_recorder.add(FrameStats::Display, phase_begin);
+			std::size_t shape_count = (prepared_frame) ? prepared_frame->range_vec.size() : 0;
+			frame_stats_recorder.current.shape_count = shape_count;
+			frame_stats_recorder.current.culled_shape_count = shape_count - std::min(shape_count, frame_stats_recorder.current.drawn_shape_count);
+			frame_stats_recorder.current.triangle_count = frame_stats_recorder.current.vertex_count / 3;
+			frame_stats_recorder.endFrame();
 		}
 		window_mutex.unlock();
-		std::this_thread::sleep_for(std::chrono::milliseconds(update_interval));
+
+		//sleep until woken by a producer, input needs polling or a pending frame is due
+		//SFML can not wake a thread waiting for input, so input is polled, slower once the window has been idle for a while
+		//but never slower than one frame, so the first input after idle is not delayed more than a frame
+		std::chrono::steady_clock::duration timeout = std::chrono::milliseconds(input_poll_interval);
+		if (now - last_input_time > std::chrono::milliseconds(idle_after)) {
+			timeout = std::chrono::milliseconds(std::min(idle_poll_interval, update_interval));
+		}
+		if (invalidation != 0) {
+			timeout = std::min(timeout, std::chrono::duration_cast<std::chrono::steady_clock::duration>(frame_interval - (now - last_render_time)));
+		}
+		std::unique_lock<std::mutex> m_lock(wake_mutex);
+		wake_condition.wait_for(m_lock, timeout, [this]() { return wake_pending || !running; });
+		wake_pending = false;
 	}
+	//running is already false, taking the mutex makes sure prep_thread sees it before waiting
+	{
+		std::unique_lock<std::mutex> m_lock(prep_mutex);
+		prep_condition.notify_one();
+	}
+	prep_thread.join();
 	//kill window
 	window.close();
 }
 
+void Window::applyCoalescedInput() {
+	if (input_zoom != 1.f) {
+		zoomViewAtPixel(input_zoom_pixel, world_view, window, input_zoom);
+		input_zoom = 1.f;
+		invalidate(InvalidateView);
+	}
+	if (!input_mouse_moved) {
+		return;
+	}
+	input_mouse_moved = false;
+	//moving without dragging only redraws if hover or snap changes
+	if (mouse_move && mouse_left_bounce) {
+		mouse_current_pos = window.mapPixelToCoords(mouse_pos, world_view);
+		sf::Vector2f m = mouse_start_pos - mouse_current_pos;
+		world_view.move(m);
+		hover_shape_id = null_shape_id;
+		invalidate(InvalidateView);
+	}
+	if (m_make_polygon_mode) {
+		bool valid = snapPixel(mouse_pos, snap_point);
+		if (valid || snap_point_valid) {
+			invalidate(InvalidateUI);
+		}
+		snap_point_valid = valid;
+	}
+	if (select_drag) {
+		select_current_pos = window.mapPixelToCoords(mouse_pos, world_view);
+		invalidate(InvalidateUI);
+	}
+	else if (!mouse_left_bounce) {
+		ShapeId id = null_shape_id;
+		if (diagram_area.contains(static_cast<float>(mouse_pos.x), static_cast<float>(mouse_pos.y))) {
+			id = pickDrawObject(mouse_pos);
+		}
+		//tooltip follows mouse, only a new id redraws the scene
+		if (id != hover_shape_id) {
+			hover_shape_id = id;
+			invalidate(InvalidateUI);
+		}
+		else if (id != null_shape_id) {
+			invalidate(InvalidateOverlay);
+		}
+	}
+}
+
+void Window::prepHandler() {
+	std::shared_ptr<const PreparedFrame> frame;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> m_lock(prep_mutex);
+			prep_condition.wait(m_lock, [this]() { return prep_pending || !running; });
+			if (!running) {
+				return;
+			}
+			prep_pending = false;
+		}
+		//snapshots published while preparing are skipped, the next pass takes the latest
+		std::shared_ptr<const DrawObjectSnapshot> snapshot = getDrawObjectSnapshot();
+		if (frame && frame->snapshot == snapshot) {
+			continue;
+		}
+		frame = PreparedFrame::prepare(snapshot, frame);
+		std::atomic_store(&prepared_frame_next, frame);
+		wake();
+	}
+}
+
+void Window::wakePrepThread() {
+	std::unique_lock<std::mutex> m_lock(prep_mutex);
+	prep_pending = true;
+	prep_condition.notify_one();
+}
+
+bool Window::takePreparedFrame() {
+	std::shared_ptr<const PreparedFrame> frame = std::atomic_load(&prepared_frame_next);
+	if (!frame || frame == prepared_frame) {
+		return false;
+	}
+	//indices of shapes already in tiles are still valid if shapes were only added, their vertices if nothing was restyled
+	//compared with the frame drawn last, not the one it was prepared from, since frames may be skipped
+	if (!prepared_frame || prepared_frame->snapshot->rebuild_version != frame->snapshot->rebuild_version) {
+		draw_object_tile_map.clear();
+		draw_object_tile_cached_vertex_count = 0;
+	}
+	else if (prepared_frame->snapshot->style_class_map != frame->snapshot->style_class_map) {
+		for (std::pair<const std::uint64_t, DrawObjectTile> & tile_pair : draw_object_tile_map) {
+			tile_pair.second.vertex_dirty = true;
+		}
+	}
+	prepared_frame = frame;
+	frame_stats_recorder.add(FrameStats::Prepare, frame->prepare_ms);
+	return true;
+}
+
 void Window::setMouseMove(bool v) {
 	std::unique_lock<std::mutex> m_lock(window_mutex);
 	mouse_move_button.setToggle(v);
+	ui_texture_dirty = true;
+	requestFrame(InvalidateUI);
 }
 
 void Window::setLockScreenScale(bool v) {
 	std::unique_lock<std::mutex> m_lock(window_mutex);
 	lock_world_view_scale_button.setToggle(v);
+	ui_texture_dirty = true;
+	requestFrame(InvalidateUI);
 }
 
 void GeometryDisplay::zoomViewAtPixel(sf::Vector2i pixel, sf::View & view, sf::RenderWindow & window, float zoom) {
@@ -598,70 +856,83 @@ void Window::updateView() {
 }
 
 void Window::renderUI() {
-	//render border rectangles
-	ui_vertex_array.clear();
-	std::vector<wykobi::rectangle<float>> rect_vec(4);
-	float win_width = screen_view.getSize().x;
-	float win_height = screen_view.getSize().y;
-	//top
-	rect_vec[0] = (wykobi::make_rectangle(0.f, 0.f, win_width, ui_border_thickness));
-	//bottom
-	rect_vec[1] = (wykobi::make_rectangle(0.f, win_height - ui_border_thickness, win_width, win_height));
-	//left
-	rect_vec[2] = (wykobi::make_rectangle(0.f, ui_border_thickness, ui_border_thickness, win_height - ui_border_thickness));
-	//right
-	rect_vec[3] = (wykobi::make_rectangle(win_width - ui_border_thickness, ui_border_thickness, win_width, win_height - ui_border_thickness));
-	for (wykobi::rectangle<float> & rect : rect_vec) {
-		wykobi::polygon<float, 2> poly = wykobi::make_polygon(rect);
-		std::vector<wykobi::triangle<float, 2>> tri_vec;
-		wykobi::algorithm::polygon_triangulate<wykobi::point2d<float>>(poly, std::back_inserter(tri_vec));
-		for (wykobi::triangle<float, 2> & tri : tri_vec) {
-			for (std::size_t i = 0; i < tri.size(); ++i) {
-				sf::Vertex v;
-				v.position = sf::Vector2f(tri[i].x, tri[i].y);
-				v.color = ui_border_color;
-				ui_vertex_array.append(v);
+	if (ui_texture_dirty) {
+		ui_texture_dirty = false;
+		//render border rectangles
+		ui_vertex_array.clear();
+		float win_width = screen_view.getSize().x;
+		float win_height = screen_view.getSize().y;
+		std::array<wykobi::rectangle<float>, 4> rect_arr = {
+			wykobi::make_rectangle(0.f, 0.f, win_width, ui_border_thickness),															//top
+			wykobi::make_rectangle(0.f, win_height - ui_border_thickness, win_width, win_height),										//bottom
+			wykobi::make_rectangle(0.f, ui_border_thickness, ui_border_thickness, win_height - ui_border_thickness),						//left
+			wykobi::make_rectangle(win_width - ui_border_thickness, ui_border_thickness, win_width, win_height - ui_border_thickness)	//right
+		};
+		for (const wykobi::rectangle<float> & rect : rect_arr) {
+			sf::Vector2f corner_arr[4] = {
+				{ rect[0].x, rect[0].y },
+				{ rect[1].x, rect[0].y },
+				{ rect[1].x, rect[1].y },
+				{ rect[0].x, rect[1].y }
+			};
+			for (std::size_t i : { 0, 1, 2, 0, 2, 3 }) {
+				ui_vertex_array.append(sf::Vertex(corner_arr[i], ui_border_color));
 			}
 		}
+		sf::Vector2u texture_size(static_cast<unsigned int>(win_width), static_cast<unsigned int>(win_height));
+		ui_texture_valid = texture_size.x > 0 && texture_size.y > 0 && (ui_texture.getSize() == texture_size || ui_texture.create(texture_size.x, texture_size.y));
+		if (ui_texture_valid) {
+			ui_texture.clear(sf::Color::Transparent);
+			ui_texture.setView(screen_view);
+			drawUIChrome(ui_texture);
+			ui_texture.display();
+		}
 	}
 	window.setView(screen_view);
-	window.draw(ui_vertex_array);
+	if (ui_texture_valid) {
+		window.draw(sf::Sprite(ui_texture.getTexture()));
+	}
+	else {
+		drawUIChrome(window);
+	}
+}
+
+void Window::drawUIChrome(sf::RenderTarget & target) {
+	target.draw(ui_vertex_array);
+	target.draw(clear_draw_object_vec_button);
+	target.draw(load_draw_object_button);
+	target.draw(save_draw_object_button);
+	target.draw(mouse_move_button);
+	target.draw(show_draw_object_name_button);
+	target.draw(lock_world_view_scale_button);
+	target.draw(auto_size_button);
+	target.draw(frame_stats_button);
+	target.draw(make_polygon_button);
+	target.draw(select_button);
+	target.draw(save_selection_button);
 }
 
 void Window::autoLineResolution() {
-	//float x = world_view.getSize().x / 10;
-	//
-	////while (x < )
-	//
-	////float y = world_view.getSize().y / 10;
-	//
-	//x = std::pow(std::floor(std::log2(x)), 2);
-	////y = std::pow(std::floor(std::log2(y)), 2);
-	//
-	//diagram_line_resolution.x = x;
-	//diagram_line_resolution.y = x;
+	if (!auto_line_resolution || diagram_area.width <= 0.f || diagram_area.height <= 0.f) {
+		return;
+	}
+	//spacing is kept above both the pixel gap and the line cap
+	float world_width = std::abs(world_view.getSize().x);
+	float world_height = std::abs(world_view.getSize().y);
+	float min_x = std::max(world_width / diagram_area.width * diagram_line_min_spacing, world_width / static_cast<float>(max_diagram_line_count - 1));
+	float min_y = std::max(world_height / diagram_area.height * diagram_line_min_spacing, world_height / static_cast<float>(max_diagram_line_count - 1));
+	if (min_x > 0.f && std::isfinite(min_x)) {
+		diagram_line_resolution.x = getNiceLineResolution(min_x, diagram_major_line_ratio.x);
+	}
+	if (min_y > 0.f && std::isfinite(min_y)) {
+		diagram_line_resolution.y = getNiceLineResolution(min_y, diagram_major_line_ratio.y);
+	}
 }
 
 void Window::autoSize() {
-	draw_object_vec_mutex.lock();
-	if (!draw_object_vec.empty()) {
-		wykobi::rectangle<float> outer_rect;
-		outer_rect = draw_object_vec.front()->getBoundingRectangle();
-		for (auto it = draw_object_vec.begin() + 1; it != draw_object_vec.end(); ++it) {
-			wykobi::rectangle<float> inner_rect = (*it)->getBoundingRectangle();
-			if (inner_rect[0].x < outer_rect[0].x) {
-				outer_rect[0].x = inner_rect[0].x;
-			}
-			if (inner_rect[0].y < outer_rect[0].y) {
-				outer_rect[0].y = inner_rect[0].y;
-			}
-			if (inner_rect[1].x > outer_rect[1].x) {
-				outer_rect[1].x = inner_rect[1].x;
-			}
-			if (inner_rect[1].y > outer_rect[1].y) {
-				outer_rect[1].y = inner_rect[1].y;
-			}
-		}
+	//root of the spatial index is the union of the cached shape bounds, kept up to date by applySceneCommands
+	wykobi::rectangle<float> outer_rect;
+	if (draw_object_spatial_index.getBoundingRectangle(outer_rect)) {
 		wykobi::point2d<float> centre = wykobi::centroid(outer_rect);
 		wykobi::vector2d<float> size;
 		if (!lock_world_view_scale) {
@@ -682,7 +953,6 @@ void Window::autoSize() {
 		world_view.setSize({ size.x, size.y });
 
 	}
-	draw_object_vec_mutex.unlock();
 }
 
 void Window::loadShapeFromFile() {
@@ -701,34 +971,13 @@ void Window::loadShapeFromFile() {
 }
 
 void Window::loadShapeFromFile(std::string path) {
-	std::fstream file;
-	std::string line;
-	file.open(path);
-	draw_object_vec_mutex.lock();
-	while (std::getline(file, line)) {
-		std::unordered_map<std::string, std::string> settings_map;
-		auto vec_1 = splitString(line, ' ');
-		for (std::string & str : vec_1) {
-			auto vec_2 = splitString(str, '=');
-			if (vec_2.size() == 2) {
-				settings_map.emplace(vec_2[0], vec_2[1]);
-			}
-		}
-		//check type
-		std::unordered_map<std::string, std::string>::iterator it;
-		it = settings_map.find("type");
-		if (it != settings_map.end()) {
-			if (it->second == "polygon") {
-				draw_object_vec.push_back	(std::unique_ptr<DrawObject>(new PolygonShape(settings_map)));
-			}
-			else if (it->second == "line") {
-				draw_object_vec.push_back(std::unique_ptr<DrawObject>(new LineShape(settings_map)));
-			}
-		}
+	std::vector<std::shared_ptr<const DrawObject>> shape_vec;
+	if (!parseShapeFile(path, detect_instances, shape_vec)) {
+		return;
+	}
+	for (std::shared_ptr<const DrawObject> & shape : shape_vec) {
+		pushSceneCommand({ SceneCommand::Add, next_shape_id++, makeStoredShape(std::move(shape)) });
 	}
-	draw_object_vec_mutex.unlock();
-
-	file.close();
 }
 
 void Window::saveShapeToFile() {
@@ -746,14 +995,83 @@ void Window::saveShapeToFile() {
 	}
 }
 void Window::saveShapeToFile(std::string path) {
-	draw_object_vec_mutex.lock();
+	writeShapeFile(path, nullptr);
+}
+void Window::saveShapeToFile(std::string path, const std::vector<ShapeId> & id_vec) {
+	std::unordered_set<ShapeId> id_set(id_vec.begin(), id_vec.end());
+	writeShapeFile(path, &id_set);
+}
+void Window::saveSelectionToFile() {
+	FileDialog::SaveFile dialog;
+	dialog.create();
+	if (dialog.getStatus() == FileDialog::Success) {
+		saveShapeToFile(dialog.getPath(), selected_id_vec);
+	}
+	else if (dialog.getStatus() == FileDialog::Closed) {
+		return;
+	}
+	else {
+		std::cout << "Error: FileDialog failed\n";
+		return;
+	}
+}
+void Window::saveSvgToFile() {
+	FileDialog::SaveFile dialog;
+	dialog.create();
+	if (dialog.getStatus() == FileDialog::Success) {
+		saveSvgToFile(dialog.getPath(), false, 0.f);
+	}
+	else if (dialog.getStatus() == FileDialog::Closed) {
+		return;
+	}
+	else {
+		std::cout << "Error: FileDialog failed\n";
+		return;
+	}
+}
+void Window::saveSvgToFile(std::string path, bool view_only, float min_pixel_size) {
+	std::shared_ptr<const DrawObjectSnapshot> snapshot = getDrawObjectSnapshot();
+	sf::Vector2f centre;
+	sf::Vector2f view_size;
+	sf::Vector2u size;
+	{
+		std::unique_lock<std::mutex> m_lock(window_mutex);
+		centre = world_view.getCenter();
+		view_size = world_view.getSize();
+		size = sf::Vector2u(static_cast<unsigned int>(std::max(diagram_area.width, 1.f)), static_cast<unsigned int>(std::max(diagram_area.height, 1.f)));
+	}
+	std::vector<std::shared_ptr<const DrawObject>> shape_vec = snapshot->draw_object_vec.toVector();
+	for (std::shared_ptr<const DrawObject> & shape : shape_vec) {
+		shape = resolveStyleClass(shape, *snapshot->style_class_map);
+	}
+	wykobi::rectangle<float> world_rect;
+	if (view_only) {
+		world_rect = wykobi::make_rectangle(centre.x - view_size.x / 2.f, centre.y - view_size.y / 2.f, centre.x + view_size.x / 2.f, centre.y + view_size.y / 2.f);
+	}
+	else {
+		world_rect = fitWorldRectangle(shape_vec, size);
+	}
+	writeSvgFile(path, shape_vec, world_rect, size, view_only, min_pixel_size);
+}
+void Window::writeShapeFile(std::string path, const std::unordered_set<ShapeId>* id_set) {
+	std::shared_ptr<const DrawObjectSnapshot> snapshot = getDrawObjectSnapshot();
 	std::ofstream file;
 	file.open(path);
-	for (auto it = draw_object_vec.begin(); it != draw_object_vec.end(); ++it) {
-		file << (*it)->toString();
+	//prototypes are declared before their first instance
+	std::unordered_map<std::size_t, bool> prototype_written_map;
+	for (std::size_t i = 0; i < snapshot->draw_object_vec.size(); ++i) {
+		if (id_set != nullptr && id_set->find(snapshot->id_vec[i]) == id_set->end()) {
+			continue;
+		}
+		std::shared_ptr<const DrawObject> shape = resolveStyleClass(snapshot->draw_object_vec[i], *snapshot->style_class_map);
+		const InstanceShape* instance = dynamic_cast<const InstanceShape*>(shape.get());
+		if (instance != nullptr && prototype_written_map.emplace(instance->prototype->id, true).second) {
+			file << instance->prototype->toString();
+			file << '\n';
+		}
+		file << shape->toString();
 		file << '\n';
 	}
-	draw_object_vec_mutex.unlock();
 	file.flush();
 	file.close();
 }
@@ -762,7 +1080,33 @@ float GeometryDisplay::getClosestPointInRes(float v, float res) {
 	return v - std::fmod(v, res);
 }
 
-wykobi::rectangle<float> GeometryDisplay::getBoundingRectangle(wykobi::polygon<float, 2> & poly) {
+float GeometryDisplay::getNiceLineResolution(float min_resolution, unsigned int & out_major_ratio) {
+	double power = std::pow(10.0, std::floor(std::log10(static_cast<double>(min_resolution))));
+	double mantissa = min_resolution / power;
+	double nice;
+	if (mantissa <= 1.0) {
+		nice = 1.0;
+		out_major_ratio = 5;
+	}
+	else if (mantissa <= 2.0) {
+		nice = 2.0;
+		out_major_ratio = 5;
+	}
+	else if (mantissa <= 5.0) {
+		nice = 5.0;
+		out_major_ratio = 2;
+	}
+	else {
+		nice = 10.0;
+		out_major_ratio = 5;
+	}
+	return static_cast<float>(nice * power);
+}
+
+wykobi::rectangle<float> GeometryDisplay::getBoundingRectangle(const wykobi::polygon<float, 2> & poly) {
+	if (poly.size() == 0) {
+		return wykobi::make_rectangle(0.f, 0.f, 0.f, 0.f);
+	}
 	wykobi::point2d<float> low_point = poly[0];
 	wykobi::point2d<float> high_point = poly[0];
 	for (std::size_t i = 1; i < poly.size(); ++i) {
@@ -782,207 +1126,1178 @@ wykobi::rectangle<float> GeometryDisplay::getBoundingRectangle(wykobi::polygon<f
 	return wykobi::make_rectangle(low_point, high_point);
 }
 
-void Window::renderLines() {
+void Window::renderLines(bool rebuild) {
+	window.setView(screen_view);
+	if (!rebuild) {
+		window.draw(diagram_vertex_array);
+		for (const sf::Text & t : diagram_text_vector) {
+			window.draw(t);
+		}
+		return;
+	}
 	diagram_vertex_array.clear();
-	diagram_text_vector.clear();
 	
 	autoLineResolution();
 
-	wykobi::polygon<float, 2> world_poly(4);
-	sf::Vector2f p;
-	p = window.mapPixelToCoords(sf::Vector2i((int)diagram_area.left, (int)diagram_area.top), world_view);
-	world_poly[0] = wykobi::make_point(p.x, p.y);
-	p = window.mapPixelToCoords(sf::Vector2i((int)diagram_area.left + (int)diagram_area.width, (int)diagram_area.top), world_view);
-	world_poly[1] = wykobi::make_point(p.x, p.y);
-	p = window.mapPixelToCoords(sf::Vector2i((int)diagram_area.left + (int)diagram_area.width, (int)diagram_area.top + (int)diagram_area.height), world_view);
-	world_poly[2] = wykobi::make_point(p.x, p.y);
-	p = window.mapPixelToCoords(sf::Vector2i((int)diagram_area.left, (int)diagram_area.top + (int)diagram_area.height), world_view);
-	world_poly[3] = wykobi::make_point(p.x, p.y);
-
-	wykobi::rectangle<float> bounding_rect = getBoundingRectangle(world_poly);
-
-	float x, y;
-	float max_x, max_y;
-
-	max_x = bounding_rect[1].x;
-	max_y = bounding_rect[1].y;
-	
-	std::vector<wykobi::segment<float, 2>> vertical_segments;
-	std::vector<wykobi::segment<float, 2>> horizontal_segments;
-
-	//vertical lines
-	x = getClosestPointInRes(bounding_rect[0].x, diagram_line_resolution.x);
-	y = bounding_rect[0].y;
-	while (x < max_x) {
-		wykobi::segment<float, 2> seg = wykobi::make_segment(x, y, x, max_y);
-		if (segmentIntersectPolygon(seg, world_poly)) {
-			wykobi::segment<float, 2> draw_seg;
-			bool first = false;
-			for (std::size_t i = 0; i < world_poly.size(); ++i) {
-				wykobi::segment<float, 2> test_seg = wykobi::edge(world_poly, i);
-				if (wykobi::intersect(seg, test_seg)) {
-					if (!first) {
-						draw_seg[0] = wykobi::intersection_point(seg, test_seg);
-						first = true;
-					}
-					else {
-						draw_seg[1] = wykobi::intersection_point(seg, test_seg);
-						break;
-					}
-				}
+	//world_view is never rotated, so grid lines are found from the visible rectangle directly
+	float left = diagram_area.left;
+	float top = diagram_area.top;
+	float right = diagram_area.left + diagram_area.width;
+	float bottom = diagram_area.top + diagram_area.height;
+	sf::Vector2f world_top_left = window.mapPixelToCoords(sf::Vector2i((int)left, (int)top), world_view);
+	sf::Vector2f world_bottom_right = window.mapPixelToCoords(sf::Vector2i((int)right, (int)bottom), world_view);
+	float world_width = world_bottom_right.x - world_top_left.x;
+	float world_height = world_bottom_right.y - world_top_left.y;
+	std::size_t text_count = 0;
+	if (world_width != 0.f && world_height != 0.f && diagram_line_resolution.x > 0.f && diagram_line_resolution.y > 0.f) {
+		float pixel_per_x = (right - left) / world_width;
+		float pixel_per_y = (bottom - top) / world_height;
+		float min_x = std::min(world_top_left.x, world_bottom_right.x);
+		float max_x = std::max(world_top_left.x, world_bottom_right.x);
+		float min_y = std::min(world_top_left.y, world_bottom_right.y);
+		float max_y = std::max(world_top_left.y, world_bottom_right.y);
+
+		//reuse text objects from the last rebuild, only string and position change
+		auto placeText = [&](float value, sf::Vector2f position) {
+			if (text_count == diagram_text_vector.size()) {
+				sf::Text t;
+				t.setFillColor(diagram_text_color);
+				t.setFont(*text_font);
+				t.setCharacterSize(diagram_text_char_size);
+				diagram_text_vector.push_back(t);
 			}
-
-			vertical_segments.push_back(draw_seg);
-
-			for (std::size_t i = 0; i < draw_seg.size(); ++i) {
-				sf::Vertex v;
-				v.color = diagram_line_color;
-				v.position = sf::Vector2f(window.mapCoordsToPixel(sf::Vector2f(seg[i].x, seg[i].y), world_view));
-				diagram_vertex_array.append(v);
+			std::ostringstream s;
+			s << value;
+			sf::Text & t = diagram_text_vector[text_count++];
+			t.setString(s.str());
+			t.setPosition(position);
+		};
+
+		//get first line index and index step, a fixed resolution skips lines past max_diagram_line_count
+		auto lineRange = [&](float min_v, float max_v, float res, double & out_first, double & out_step) {
+			out_first = std::ceil(static_cast<double>(min_v) / res);
+			double line_count = std::floor(static_cast<double>(max_v) / res) - out_first + 1.0;
+			out_step = std::max(1.0, std::ceil(line_count / max_diagram_line_count));
+			out_first = std::ceil(out_first / out_step) * out_step;
+		};
+		double first, step;
+
+		//vertical lines, positions are computed from the line index so they do not drift
+		lineRange(min_x, max_x, diagram_line_resolution.x, first, step);
+		for (double i = first; i * diagram_line_resolution.x < max_x; i += step) {
+			float x = static_cast<float>(i * diagram_line_resolution.x);
+			float pixel_x = left + (x - world_top_left.x) * pixel_per_x;
+			bool major = std::fmod(i, static_cast<double>(diagram_major_line_ratio.x)) == 0.0;
+			sf::Color color = major ? diagram_line_color : diagram_minor_line_color;
+			diagram_vertex_array.append(sf::Vertex(sf::Vector2f(pixel_x, top), color));
+			diagram_vertex_array.append(sf::Vertex(sf::Vector2f(pixel_x, bottom), color));
+			if (major) {
+				placeText(x, sf::Vector2f(pixel_x, top - 20));	//HACK
 			}
 		}
-		x += diagram_line_resolution.x;
-	}
-	//horizontal lines
-	x = bounding_rect[0].x;
-	y = getClosestPointInRes(bounding_rect[0].y, diagram_line_resolution.y);
-	while (y < max_y) {
-		wykobi::segment<float, 2> seg = wykobi::make_segment(x, y, max_x, y);
-		if (segmentIntersectPolygon(seg, world_poly)) {
-			wykobi::segment<float, 2> draw_seg;
-			bool first = false;
-			for (std::size_t i = 0; i < world_poly.size(); ++i) {
-				wykobi::segment<float, 2> test_seg = wykobi::edge(world_poly, i);
-				if (wykobi::intersect(seg, test_seg)) {
-					if (!first) {
-						draw_seg[0] = wykobi::intersection_point(seg, test_seg);
-						first = true;
-					}
-					else {
-						draw_seg[1] = wykobi::intersection_point(seg, test_seg);
-						break;
-					}
-				}
-			}
-			horizontal_segments.push_back(draw_seg);
-			for (std::size_t i = 0; i < draw_seg.size(); ++i) {
-				sf::Vertex v;
-				v.color = diagram_line_color;
-				v.position = sf::Vector2f(window.mapCoordsToPixel(sf::Vector2f(seg[i].x, seg[i].y), world_view));
-				diagram_vertex_array.append(v);
+		//horizontal lines
+		lineRange(min_y, max_y, diagram_line_resolution.y, first, step);
+		for (double i = first; i * diagram_line_resolution.y < max_y; i += step) {
+			float y = static_cast<float>(i * diagram_line_resolution.y);
+			float pixel_y = top + (y - world_top_left.y) * pixel_per_y;
+			bool major = std::fmod(i, static_cast<double>(diagram_major_line_ratio.y)) == 0.0;
+			sf::Color color = major ? diagram_line_color : diagram_minor_line_color;
+			diagram_vertex_array.append(sf::Vertex(sf::Vector2f(left, pixel_y), color));
+			diagram_vertex_array.append(sf::Vertex(sf::Vector2f(right, pixel_y), color));
+			if (major) {
+				placeText(y, sf::Vector2f(left - 20, pixel_y));	//HACK
 			}
 		}
-		y += diagram_line_resolution.y;
 	}
+	diagram_text_vector.resize(text_count);
 
-	//text
-	window.setView(screen_view);
 	window.draw(diagram_vertex_array);
-	window.setView(screen_view);
-	for (auto & seg : vertical_segments) {
-		std::size_t index = (seg[0].y < seg[1].y) ? 0 : 1;
-		sf::Text t;
-		t.setFillColor(diagram_text_color);
-		t.setPosition(sf::Vector2f(window.mapCoordsToPixel(sf::Vector2f(seg[index].x, seg[index].y), world_view)));
-		t.setPosition({ t.getPosition().x, t.getPosition().y - 20 });	 //HACK
-		std::ostringstream s;
-		s << seg[index].x;
-		t.setFont(*text_font);
-		t.setString(s.str());
-		t.setCharacterSize(diagram_text_char_size);
-		window.draw(t);
-	}
-	for (auto & seg : horizontal_segments) {
-		std::size_t index = (seg[0].x < seg[1].x) ? 0 : 1;
-		sf::Text t;
-		t.setFillColor(diagram_text_color);
-		t.setPosition(sf::Vector2f(window.mapCoordsToPixel(sf::Vector2f(seg[index].x, seg[index].y), world_view)));
-		t.setPosition({ t.getPosition().x - 20, t.getPosition().y });	//HACK
-		std::ostringstream s;
-		s << seg[index].y;
-		t.setFont(*text_font);
-		t.setString(s.str());
-		t.setCharacterSize(diagram_text_char_size);
+	for (const sf::Text & t : diagram_text_vector) {
 		window.draw(t);
 	}
 }
 
-void Window::renderDrawObject() {
-	//render shapes
-	std::unique_lock<std::mutex> m_lock(draw_object_vec_mutex);
-	draw_object_vertex_array.clear();
-	for (auto it = draw_object_vec.begin(); it != draw_object_vec.end(); ++it) {
-		(*it)->appendVertex(draw_object_vertex_array);
+void Window::renderDrawObject(bool rebuild_labels) {
+	if (!prepared_frame) {
+		return;
 	}
+	const PreparedFrame & frame = *prepared_frame;
+	FrameStats & stats = frame_stats_recorder.current;
+	FrameStatsRecorder::Clock::time_point phase_begin = FrameStatsRecorder::Clock::now();
+
+	//draw tiles overlapping world_view, unless the whole scene is visible
+	wykobi::rectangle<float> view_rect = getWorldViewRectangle();
+	const wykobi::rectangle<float> & scene_rect = frame.bounding_rectangle;
+	bool cull = !frame.range_vec.empty() && !(
+		view_rect[0].x <= scene_rect[0].x && view_rect[0].y <= scene_rect[0].y &&
+		view_rect[1].x >= scene_rect[1].x && view_rect[1].y >= scene_rect[1].y
+	);
+
 	window.setView(world_view);
-	window.draw(draw_object_vertex_array);
+	bool collect_labels = show_draw_object_name && rebuild_labels;
+	if (!cull) {
+		for (const std::shared_ptr<const sf::VertexArray> & chunk : frame.chunk_vec) {
+			window.draw(*chunk);
+		}
+		stats.vertex_count += frame.vertex_count;
+		stats.drawn_shape_count += frame.range_vec.size();
+	}
+	else {
+		int level = getDrawObjectTileLevel(view_rect);
+		double tile_size = std::ldexp(1.0, level);
+		double tile_x0 = std::floor(view_rect[0].x / tile_size);
+		double tile_y0 = std::floor(view_rect[0].y / tile_size);
+		double tile_x1 = std::floor(view_rect[1].x / tile_size);
+		double tile_y1 = std::floor(view_rect[1].y / tile_size);
+		double tile_limit = static_cast<double>(draw_object_tile_max_coordinate);
+		if (tile_x0 > -tile_limit && tile_y0 > -tile_limit && tile_x1 < tile_limit && tile_y1 < tile_limit) {
+			++draw_object_tile_frame;
+			for (std::int32_t y = static_cast<std::int32_t>(tile_y0); y <= static_cast<std::int32_t>(tile_y1); ++y) {
+				for (std::int32_t x = static_cast<std::int32_t>(tile_x0); x <= static_cast<std::int32_t>(tile_x1); ++x) {
+					wykobi::rectangle<float> tile_rect = getDrawObjectTileRectangle(level, x, y);
+					if (!setDrawObjectTileView(tile_rect)) {
+						continue;
+					}
+					DrawObjectTile & tile = draw_object_tile_map[makeTileKey(level, x, y)];
+					tile.level = level;
+					tile.x = x;
+					tile.y = y;
+					tile.last_used = draw_object_tile_frame;
+					//count building as tessellation, not drawing
+					FrameStatsRecorder::Clock::time_point build_begin = FrameStatsRecorder::Clock::now();
+					updateDrawObjectTile(tile);
+					FrameStatsRecorder::Clock::time_point build_end = frame_stats_recorder.add(FrameStats::Tessellate, build_begin);
+					phase_begin += build_end - build_begin;
+					if (tile.overflow) {
+						drawDrawObjectCulled(tile_rect);
+					}
+					else {
+						window.draw(tile.vertex_array);
+						stats.vertex_count += tile.vertex_array.getVertexCount();
+						stats.drawn_shape_count += tile.index_vec.size();
+					}
+				}
+			}
+			window.setView(world_view);
+			evictDrawObjectTiles(level, view_rect);
+		}
+		else {
+			drawDrawObjectCulled(view_rect);
+		}
+	}
+	phase_begin = frame_stats_recorder.add(FrameStats::Draw, phase_begin);
+	if (collect_labels) {
+		draw_object_label_vec.clear();
+		if (cull) {
+			//only shapes overlapping the view can be visible
+			draw_object_cull_vec.clear();
+			frame.queryShapes(view_rect, 0, draw_object_cull_vec);
+			for (std::size_t index : draw_object_cull_vec) {
+				if (frame.snapshot->draw_object_vec[index]->name_id != 0) {
+					draw_object_label_vec.push_back(index);
+				}
+			}
+			std::sort(draw_object_label_vec.begin(), draw_object_label_vec.end(), [&frame](std::size_t a, std::size_t b) {
+				return frame.labelBefore(a, b);
+			});
+		}
+		else {
+			frame.appendLabels(nullptr, draw_object_label_vec);
+		}
+		placeDrawObjectNames();
+	}
 	if (show_draw_object_name) {
-		//render object names
 		window.setView(screen_view);
-		for (auto it = draw_object_vec.begin(); it != draw_object_vec.end(); ++it) {
-			if (!(*it)->name.empty()) {
-				sf::Text t;
-				t.setFont(*text_font);
-				t.setString((*it)->name);
-				t.setCharacterSize(draw_object_text_size);
-				t.setFillColor(contrastColor((*it)->fill_color));
-				setTextPositionCentre(t, sf::Vector2f(window.mapCoordsToPixel((*it)->getCentroid(), world_view)));
-				window.draw(t);
-			}
+		for (const sf::Text & t : draw_object_label_text_vec) {
+			window.draw(t);
 		}
+		stats.label_count = draw_object_label_text_vec.size();
+		frame_stats_recorder.add(FrameStats::Labels, phase_begin);
 	}
 }
 
-void Window::setTitle(std::string title) {
-	std::unique_lock<std::mutex> m_lock(window_mutex);
-	window_title = title;
-	update_frame = true;
+void Window::placeDrawObjectNames() {
+	const PreparedFrame & frame = *prepared_frame;
+	float char_size = static_cast<float>(draw_object_text_size);
+	draw_object_label_grid.reset(diagram_area, char_size * 4.f);
+	draw_object_label_text_vec.clear();
+	for (std::size_t index : draw_object_label_vec) {
+		const DrawObject & shape = *frame.snapshot->draw_object_vec[index];
+		const std::string & name = shape.getName();
+		sf::Vector2f pixel(window.mapCoordsToPixel(frame.centroid_vec[index], world_view));
+		//smaller than any real label, rejects most candidates before glyphs are laid out
+		float min_width = static_cast<float>(name.size()) * char_size * 0.25f;
+		float min_height = char_size * 0.5f;
+		if (draw_object_label_grid.overlaps(sf::FloatRect(pixel.x - min_width / 2.f, pixel.y - min_height / 2.f, min_width, min_height))) {
+			continue;
+		}
+		sf::Text t;
+		t.setFont(*text_font);
+		t.setString(name);
+		t.setCharacterSize(draw_object_text_size);
+		t.setFillColor(contrastColor(frame.snapshot->style_class_map->get(shape.style_id).fill_color));
+		setTextPositionCentre(t, pixel);
+		if (draw_object_label_grid.tryInsert(t.getGlobalBounds())) {
+			draw_object_label_text_vec.push_back(t);
+		}
+	}
 }
 
-void Window::setUpdateInterval(int t) {
-	std::unique_lock<std::mutex> m_lock(window_mutex);
-	update_interval = t;
+void Window::renderSelection() {
+	selection_vertex_array.clear();
+	auto appendRectangle = [&](const wykobi::rectangle<float> & rect) {
+		sf::Vector2f corner[4] = {
+			{ rect[0].x, rect[0].y },
+			{ rect[1].x, rect[0].y },
+			{ rect[1].x, rect[1].y },
+			{ rect[0].x, rect[1].y }
+		};
+		for (int i = 0; i < 4; ++i) {
+			selection_vertex_array.append(sf::Vertex(corner[i], selection_color));
+			selection_vertex_array.append(sf::Vertex(corner[(i + 1) % 4], selection_color));
+		}
+	};
+	for (ShapeId id : selected_id_vec) {
+		wykobi::rectangle<float> rect;
+		if (draw_object_spatial_index.getRectangle(id, rect)) {
+			appendRectangle(rect);
+		}
+	}
+	if (select_drag) {
+		appendRectangle(SpatialIndex::normalizeRectangle(wykobi::make_rectangle(select_start_pos.x, select_start_pos.y, select_current_pos.x, select_current_pos.y)));
+	}
+	if (selection_vertex_array.getVertexCount() > 0) {
+		window.setView(world_view);
+		window.draw(selection_vertex_array);
+	}
 }
 
-void Window::setWindowSize(int w, int h) {
-	std::unique_lock<std::mutex> m_lock(window_mutex);
-	window_size = { static_cast<unsigned int>(w), static_cast<unsigned int>(h) };
-	update_frame = true;
+void Window::queryDrawObject(const wykobi::polygon<float, 2> & region, std::vector<ShapeId> & out_vec) {
+	if (region.size() < 3) {
+		return;
+	}
+	std::vector<std::size_t> candidate_vec;
+	draw_object_spatial_index.query(getBoundingRectangle(region), [&](std::size_t id) {
+		auto it = draw_object_index_map.find(id);
+		if (it != draw_object_index_map.end()) {
+			candidate_vec.push_back(it->second);
+		}
+		return true;
+	});
+	std::sort(candidate_vec.begin(), candidate_vec.end());
+
+	//shapes are immutable, so threads can test them without locking
+	std::vector<char> hit_vec(candidate_vec.size(), 0);
+	auto refine = [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i) {
+			hit_vec[i] = draw_object_vec[candidate_vec[i]]->intersectsPolygon(region) ? 1 : 0;
+		}
+	};
+	std::size_t thread_count = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), candidate_vec.size() / query_thread_batch_size + 1);
+	if (thread_count <= 1) {
+		refine(0, candidate_vec.size());
+	}
+	else {
+		std::vector<std::thread> thread_vec;
+		std::size_t chunk = (candidate_vec.size() + thread_count - 1) / thread_count;
+		for (std::size_t begin = chunk; begin < candidate_vec.size(); begin += chunk) {
+			thread_vec.emplace_back(refine, begin, std::min(begin + chunk, candidate_vec.size()));
+		}
+		refine(0, std::min(chunk, candidate_vec.size()));
+		for (std::thread & t : thread_vec) {
+			t.join();
+		}
+	}
+	for (std::size_t i = 0; i < candidate_vec.size(); ++i) {
+		if (hit_vec[i]) {
+			out_vec.push_back(draw_object_id_vec[candidate_vec[i]]);
+		}
+	}
 }
 
-void Window::setDiagramPosition(float x, float y) {
-	std::unique_lock<std::mutex> m_lock(window_mutex);
-	world_view.setCenter(x + world_view.getSize().x / 2, y + world_view.getSize().y / 2);
-	update_frame = true;
+std::vector<ShapeId> Window::queryRect(wykobi::rectangle<float> rect) {
+	rect = SpatialIndex::normalizeRectangle(rect);
+	wykobi::polygon<float, 2> region = makeRectanglePolygon(rect);
+	return queryPolygon(region);
 }
 
-void Window::setDiagramLineResolution(float x, float y) {
+std::vector<ShapeId> Window::queryPolygon(wykobi::polygon<float, 2> poly) {
 	std::unique_lock<std::mutex> m_lock(window_mutex);
-	diagram_line_resolution.x = x;
-	diagram_line_resolution.y = y;
-	update_frame = true;
-}
-
-void Window::addShape(DrawObject & shape) {
-	std::unique_lock<std::mutex> m_lock(draw_object_vec_mutex);
-	draw_object_vec.push_back(std::unique_ptr<DrawObject>(shape.clone()));
-	update_frame = true;
+	std::vector<ShapeId> id_vec;
+	queryDrawObject(poly, id_vec);
+	return id_vec;
 }
 
-void Window::addShape(std::unique_ptr<DrawObject> & ptr) {
-	std::unique_lock<std::mutex> m_lock(draw_object_vec_mutex);
-	draw_object_vec.push_back(std::move(ptr));
-	update_frame = true;
+std::vector<ShapeId> Window::getSelection() {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	return selected_id_vec;
 }
 
-void Window::addShape(wykobi::polygon<float, 2> poly) {
-	PolygonShape shape(poly);
-	addShape(shape);
+void Window::updateSnapTree() {
+	if (snap_tree_future.valid()) {
+		if (snap_tree_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return;
+		}
+		snap_tree = snap_tree_future.get();
+		snap_pending_vec.erase(snap_pending_vec.begin(), snap_pending_vec.begin() + snap_pending_build_count);
+		snap_pending_begin += snap_pending_build_count;
+		snap_pending_build_count = 0;
+		//blocks wholly in snap_tree are dropped, a block reaching past it is kept, corners found twice are harmless
+		snap_block_vec.erase(std::remove_if(snap_block_vec.begin(), snap_block_vec.end(), [this](const SnapBlock & block) {
+			return block.end <= snap_pending_begin;
+		}), snap_block_vec.end());
+		snap_block_end = std::max(snap_block_end, snap_pending_begin);
+	}
+	std::size_t rebuild_count = std::max(snap_pending_rebuild_count, (snap_tree) ? snap_tree->size() / 8 : 0);
+	if (snap_tree_stale || !snap_tree || snap_pending_vec.size() > rebuild_count) {
+		startSnapTreeBuild();
+	}
+	updateSnapPendingTree();
+}
+
+void Window::updateSnapPendingTree() {
+	if (snap_block_future.valid() && snap_block_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		//replace the blocks that were merged, unless snap_tree has caught up with them meanwhile
+		SnapBlock merged = snap_block_future.get();
+		std::vector<SnapBlock>::iterator first = std::find_if(snap_block_vec.begin(), snap_block_vec.end(), [&merged](const SnapBlock & block) {
+			return block.begin >= merged.begin;
+		});
+		std::vector<SnapBlock>::iterator last = std::find_if(first, snap_block_vec.end(), [&merged](const SnapBlock & block) {
+			return block.begin >= merged.end;
+		});
+		first = snap_block_vec.erase(first, last);
+		if (merged.end > snap_pending_begin) {
+			snap_block_vec.insert(first, std::move(merged));
+		}
+	}
+	std::size_t pending_end = snap_pending_begin + snap_pending_vec.size();
+	if (pending_end - snap_block_end > snap_pending_linear_count) {
+		snap_block_vec.push_back(makeSnapBlock(snap_block_end, pending_end));
+		snap_block_end = pending_end;
+	}
+	while (snap_block_vec.size() >= 2) {
+		const SnapBlock & a = snap_block_vec[snap_block_vec.size() - 2];
+		const SnapBlock & b = snap_block_vec.back();
+		if (a.end - a.begin > (b.end - b.begin) * 2 || (snap_block_future.valid() && a.end <= snap_block_merge_end)) {
+			break;
+		}
+		if (a.tree->size() + b.tree->size() <= snap_block_sync_count) {
+			SnapBlock merged = mergeSnapBlock(a, b);
+			snap_block_vec.pop_back();
+			snap_block_vec.back() = std::move(merged);
+			continue;
+		}
+		//a and b stay searchable until the merge is taken, later blocks wait with their merges until then
+		if (!snap_block_future.valid()) {
+			snap_block_merge_end = b.end;
+			snap_block_future = std::async(std::launch::async, &Window::mergeSnapBlock, a, b);
+		}
+		break;
+	}
 }
 
-void Window::addShape(wykobi::segment<float, 2> seg) {
-	LineShape shape(seg);
-	addShape(shape);
+SnapBlock Window::mergeSnapBlock(const SnapBlock & a, const SnapBlock & b) {
+	const std::vector<sf::Vector2f> & a_point_vec = a.tree->getPoints();
+	const std::vector<sf::Vector2f> & b_point_vec = b.tree->getPoints();
+	std::vector<sf::Vector2f> point_vec;
+	point_vec.reserve(a_point_vec.size() + b_point_vec.size());
+	point_vec.insert(point_vec.end(), a_point_vec.begin(), a_point_vec.end());
+	point_vec.insert(point_vec.end(), b_point_vec.begin(), b_point_vec.end());
+	SnapBlock block;
+	block.tree = std::make_shared<PointKdTree>(std::move(point_vec));
+	block.begin = a.begin;
+	block.end = b.end;
+	return block;
+}
+
+SnapBlock Window::makeSnapBlock(std::size_t begin, std::size_t end) {
+	SnapBlock block;
+	block.tree = std::make_shared<PointKdTree>(std::vector<sf::Vector2f>(snap_pending_vec.begin() + (begin - snap_pending_begin), snap_pending_vec.begin() + (end - snap_pending_begin)));
+	block.begin = begin;
+	block.end = end;
+	return block;
+}
+
+void Window::startSnapTreeBuild() {
+	//snapshot holds every shape applied so far, so it covers all of snap_pending_vec
+	std::shared_ptr<const DrawObjectSnapshot> snapshot = getDrawObjectSnapshot();
+	snap_pending_build_count = snap_pending_vec.size();
+	snap_tree_stale = false;
+	snap_tree_future = std::async(std::launch::async, [snapshot]() {
+		std::vector<sf::Vector2f> point_vec;
+		for (std::size_t i = 0; i < snapshot->draw_object_vec.size(); ++i) {
+			snapshot->draw_object_vec[i]->appendCornerPoints(point_vec);
+		}
+		return std::shared_ptr<const PointKdTree>(std::make_shared<PointKdTree>(std::move(point_vec)));
+	});
+}
+
+bool Window::snapPixel(sf::Vector2i pixel, sf::Vector2f & out_point) {
+	sf::Vector2f point = window.mapPixelToCoords(pixel, world_view);
+	float radius = snap_radius * world_view.getSize().x / std::max(diagram_area.width, 1.f);
+	float best_distance = radius;
+	bool found = false;
+	//corners first
+	updateSnapPendingTree();
+	sf::Vector2f p;
+	auto searchTree = [&](const PointKdTree* tree) {
+		if (tree != nullptr && tree->nearest(point, best_distance, p)) {
+			sf::Vector2f e = p - point;
+			best_distance = std::sqrt(e.x * e.x + e.y * e.y);
+			out_point = p;
+			found = true;
+		}
+	};
+	searchTree(snap_tree.get());
+	for (const SnapBlock & block : snap_block_vec) {
+		searchTree(block.tree.get());
+	}
+	for (std::size_t i = snap_block_end - snap_pending_begin; i < snap_pending_vec.size(); ++i) {
+		const sf::Vector2f & pending_point = snap_pending_vec[i];
+		sf::Vector2f e = pending_point - point;
+		float distance = std::sqrt(e.x * e.x + e.y * e.y);
+		if (distance <= best_distance) {
+			best_distance = distance;
+			out_point = pending_point;
+			found = true;
+		}
+	}
+	if (found) {
+		return true;
+	}
+	//then outlines of shapes near point
+	wykobi::rectangle<float> query_rect = wykobi::make_rectangle(point.x - radius, point.y - radius, point.x + radius, point.y + radius);
+	draw_object_spatial_index.query(query_rect, [&](std::size_t id) {
+		auto it = draw_object_index_map.find(id);
+		if (it != draw_object_index_map.end()) {
+			float distance = closestOutlinePoint(id, *draw_object_vec[it->second], point, best_distance, p);
+			if (distance <= best_distance) {
+				best_distance = distance;
+				out_point = p;
+				found = true;
+			}
+		}
+		return true;
+	});
+	return found;
+}
+
+float Window::closestOutlinePoint(ShapeId id, const DrawObject & shape, sf::Vector2f point, float max_distance, sf::Vector2f & out_point) {
+	float best_distance = std::numeric_limits<float>::infinity();
+	auto testSegment = [&](const wykobi::segment<float, 2> & seg) {
+		sf::Vector2f p = closestSegmentPoint(point, seg);
+		sf::Vector2f e = p - point;
+		float distance = std::sqrt(e.x * e.x + e.y * e.y);
+		if (distance <= max_distance && distance < best_distance) {
+			best_distance = distance;
+			out_point = p;
+		}
+	};
+	auto it = snap_outline_index_map.find(id);
+	if (it == snap_outline_index_map.end()) {
+		snap_outline_segment_vec.clear();
+		shape.appendOutlineSegments(snap_outline_segment_vec);
+		if (snap_outline_segment_vec.size() < snap_outline_index_min_count) {
+			for (const wykobi::segment<float, 2> & seg : snap_outline_segment_vec) {
+				testSegment(seg);
+			}
+			return best_distance;
+		}
+		if (snap_outline_index_map.size() >= snap_outline_index_max_count) {
+			snap_outline_index_map.clear();
+		}
+		std::unique_ptr<OutlineSegmentIndex> outline_index(new OutlineSegmentIndex());
+		outline_index->segment_vec.swap(snap_outline_segment_vec);
+		for (std::size_t i = 0; i < outline_index->segment_vec.size(); ++i) {
+			const wykobi::segment<float, 2> & seg = outline_index->segment_vec[i];
+			outline_index->index.insert(i, SpatialIndex::normalizeRectangle(wykobi::make_rectangle(seg[0], seg[1])));
+		}
+		it = snap_outline_index_map.emplace(id, std::move(outline_index)).first;
+	}
+	const OutlineSegmentIndex & outline_index = *it->second;
+	wykobi::rectangle<float> query_rect = wykobi::make_rectangle(point.x - max_distance, point.y - max_distance, point.x + max_distance, point.y + max_distance);
+	outline_index.index.query(query_rect, [&](std::size_t i) {
+		testSegment(outline_index.segment_vec[i]);
+		return true;
+	});
+	return best_distance;
+}
+
+void Window::renderSnapPoint() {
+	sf::Vector2f pixel(window.mapCoordsToPixel(snap_point, world_view));
+	float size = 8.f;
+	sf::RectangleShape marker({ size, size });
+	marker.setPosition(pixel.x - size / 2.f, pixel.y - size / 2.f);
+	marker.setFillColor(sf::Color::Transparent);
+	marker.setOutlineColor(snap_point_color);
+	marker.setOutlineThickness(1.f);
+	window.setView(screen_view);
+	window.draw(marker);
+}
+
+void Window::renderFrameStats() {
+	sf::Text t;
+	t.setFont(*text_font);
+	t.setString(frame_stats_recorder.getStats().toString());
+	t.setCharacterSize(hover_text_char_size);
+	t.setFillColor(hover_text_color);
+	sf::FloatRect text_bounds = t.getLocalBounds();
+	float padding = 4.f;
+	sf::Vector2f size(text_bounds.width + padding * 2.f, text_bounds.height + padding * 2.f);
+	sf::Vector2f pos(diagram_area.left + diagram_area.width - size.x, diagram_area.top);
+	sf::RectangleShape background(size);
+	background.setPosition(pos);
+	background.setFillColor(hover_background_color);
+	t.setPosition(pos.x + padding - text_bounds.left, pos.y + padding - text_bounds.top);
+	window.setView(screen_view);
+	window.draw(background);
+	window.draw(t);
+}
+
+FrameStats Window::getFrameStats() {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	return frame_stats_recorder.getStats();
+}
+
+void Window::renderHoverInfo() {
+	auto it = draw_object_index_map.find(hover_shape_id);
+	if (it == draw_object_index_map.end()) {
+		return;
+	}
+	std::shared_ptr<const DrawObject> shape = resolveStyleClass(draw_object_vec[it->second], *style_class_map);
+	std::ostringstream stream;
+	stream << "id=" << hover_shape_id << "\n";
+	//style attributes are space separated, put one on each line
+	std::string attributes = shape->DrawObject::toString();
+	std::replace(attributes.begin(), attributes.end(), ' ', '\n');
+	stream << attributes;
+	wykobi::rectangle<float> rect;
+	if (draw_object_spatial_index.getRectangle(hover_shape_id, rect)) {
+		stream << "bounds=(" << rect[0].x << "," << rect[0].y << ")-(" << rect[1].x << "," << rect[1].y << ")";
+	}
+
+	sf::Text t;
+	t.setFont(*text_font);
+	t.setString(stream.str());
+	t.setCharacterSize(hover_text_char_size);
+	t.setFillColor(hover_text_color);
+	sf::FloatRect text_bounds = t.getLocalBounds();
+	float padding = 4.f;
+	sf::Vector2f size(text_bounds.width + padding * 2.f, text_bounds.height + padding * 2.f);
+	//place below right of mouse, flip when it would leave the window
+	sf::Vector2f pos(static_cast<float>(mouse_pos.x) + 16.f, static_cast<float>(mouse_pos.y) + 16.f);
+	if (pos.x + size.x > window_size.x) {
+		pos.x = std::max(0.f, static_cast<float>(mouse_pos.x) - size.x);
+	}
+	if (pos.y + size.y > window_size.y) {
+		pos.y = std::max(0.f, static_cast<float>(mouse_pos.y) - size.y);
+	}
+	sf::RectangleShape background(size);
+	background.setPosition(pos);
+	background.setFillColor(hover_background_color);
+	background.setOutlineColor(hover_text_color);
+	background.setOutlineThickness(1.f);
+	t.setPosition(pos.x + padding - text_bounds.left, pos.y + padding - text_bounds.top);
+	window.setView(screen_view);
+	window.draw(background);
+	window.draw(t);
+}
+
+ShapeId Window::pickDrawObject(sf::Vector2i pixel) {
+	sf::Vector2f point = window.mapPixelToCoords(pixel, world_view);
+	float tolerance = pick_tolerance * world_view.getSize().x / std::max(diagram_area.width, 1.f);
+	wykobi::rectangle<float> pick_rect = wykobi::make_rectangle(point.x - tolerance, point.y - tolerance, point.x + tolerance, point.y + tolerance);
+	//topmost is the candidate drawn last
+	ShapeId pick_id = null_shape_id;
+	std::size_t pick_index = 0;
+	draw_object_spatial_index.query(pick_rect, [&](std::size_t id) {
+		auto it = draw_object_index_map.find(id);
+		if (it != draw_object_index_map.end() && (pick_id == null_shape_id || it->second > pick_index)) {
+			const DrawObject & shape = *draw_object_vec[it->second];
+			if (shape.containsStyledPoint(point, style_class_map->get(shape.style_id), tolerance)) {
+				pick_id = id;
+				pick_index = it->second;
+			}
+		}
+		return true;
+	});
+	return pick_id;
+}
+
+ShapeId Window::pickAt(sf::Vector2i pixel) {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	return pickDrawObject(pixel);
+}
+
+void Window::appendDrawObjectVertexRange(std::size_t index, sf::VertexArray & vertex_arr) {
+	const PreparedFrame::VertexRange & range = prepared_frame->range_vec[index];
+	const sf::VertexArray & chunk = *prepared_frame->chunk_vec[range.chunk];
+	for (std::size_t i = range.begin; i < range.end; ++i) {
+		vertex_arr.append(chunk[i]);
+	}
+}
+
+int Window::getDrawObjectTileLevel(const wykobi::rectangle<float> & view_rect) {
+	double size = std::max(view_rect[1].x - view_rect[0].x, view_rect[1].y - view_rect[0].y) / draw_object_tile_axis_count;
+	size = std::max(size, static_cast<double>(draw_object_tile_min_size));
+	//size is below 2^level and at least 2^(level - 1)
+	int level = 0;
+	std::frexp(size, &level);
+	return std::max(-200, std::min(level, 200));
+}
+
+wykobi::rectangle<float> Window::getDrawObjectTileRectangle(int level, std::int32_t tile_x, std::int32_t tile_y) {
+	double tile_size = std::ldexp(1.0, level);
+	return wykobi::make_rectangle(
+		static_cast<float>(tile_x * tile_size), static_cast<float>(tile_y * tile_size),
+		static_cast<float>((tile_x + 1.0) * tile_size), static_cast<float>((tile_y + 1.0) * tile_size)
+	);
+}
+
+void Window::updateDrawObjectTile(DrawObjectTile & tile) {
+	const PreparedFrame & frame = *prepared_frame;
+	std::size_t shape_count = frame.range_vec.size();
+	if (tile.overflow || (tile.shape_end == shape_count && !tile.vertex_dirty)) {
+		return;
+	}
+	wykobi::rectangle<float> tile_rect = getDrawObjectTileRectangle(tile.level, tile.x, tile.y);
+	std::size_t index_begin = tile.index_vec.size();
+	if (shape_count - tile.shape_end <= draw_object_tile_scan_count) {
+		for (std::size_t i = tile.shape_end; i < shape_count; ++i) {
+			if (SpatialIndex::rectangleIntersect(frame.bounding_rectangle_vec[i], tile_rect)) {
+				tile.index_vec.push_back(i);
+			}
+		}
+	}
+	else {
+		frame.queryShapes(tile_rect, tile.shape_end, tile.index_vec);
+		std::sort(tile.index_vec.begin() + index_begin, tile.index_vec.end());
+	}
+	tile.shape_end = shape_count;
+	std::size_t old_vertex_count = tile.vertex_array.getVertexCount();
+	if (tile.vertex_dirty) {
+		tile.vertex_array.clear();
+		index_begin = 0;
+		tile.vertex_dirty = false;
+	}
+	for (std::size_t i = index_begin; i < tile.index_vec.size(); ++i) {
+		appendDrawObjectVertexRange(tile.index_vec[i], tile.vertex_array);
+		if (tile.vertex_array.getVertexCount() > draw_object_tile_max_vertex_count) {
+			//stop caching, drawn from the chunks until the tile is rebuilt
+			tile.vertex_array = sf::VertexArray(sf::Triangles);
+			tile.index_vec = std::vector<std::size_t>();
+			tile.overflow = true;
+			break;
+		}
+	}
+	draw_object_tile_cached_vertex_count = draw_object_tile_cached_vertex_count - old_vertex_count + tile.vertex_array.getVertexCount();
+}
+
+bool Window::setDrawObjectTileView(const wykobi::rectangle<float> & tile_rect) {
+	//both corners are rounded to pixels, so neighbour tiles share their edge and no pixel is drawn twice
+	sf::Vector2i low = window.mapCoordsToPixel(sf::Vector2f(tile_rect[0].x, tile_rect[0].y), world_view);
+	sf::Vector2i high = window.mapCoordsToPixel(sf::Vector2f(tile_rect[1].x, tile_rect[1].y), world_view);
+	int left = std::max(std::min(low.x, high.x), static_cast<int>(diagram_area.left));
+	int top = std::max(std::min(low.y, high.y), static_cast<int>(diagram_area.top));
+	int right = std::min(std::max(low.x, high.x), static_cast<int>(diagram_area.left + diagram_area.width));
+	int bottom = std::min(std::max(low.y, high.y), static_cast<int>(diagram_area.top + diagram_area.height));
+	if (right <= left || bottom <= top) {
+		return false;
+	}
+	sf::Vector2f world_low = window.mapPixelToCoords(sf::Vector2i(left, top), world_view);
+	sf::Vector2f world_high = window.mapPixelToCoords(sf::Vector2i(right, bottom), world_view);
+	sf::Vector2u window_size = window.getSize();
+	sf::View tile_view;
+	tile_view.setCenter((world_low + world_high) / 2.f);
+	tile_view.setSize(world_high - world_low);
+	tile_view.setViewport(sf::FloatRect(
+		normalize(static_cast<float>(left), 0.f, (float)window_size.x),
+		normalize(static_cast<float>(top), 0.f, (float)window_size.y),
+		normalize(static_cast<float>(right - left), 0.f, (float)window_size.x),
+		normalize(static_cast<float>(bottom - top), 0.f, (float)window_size.y)
+	));
+	window.setView(tile_view);
+	return true;
+}
+
+void Window::drawDrawObjectCulled(const wykobi::rectangle<float> & rect) {
+	const PreparedFrame & frame = *prepared_frame;
+	FrameStats & stats = frame_stats_recorder.current;
+	draw_object_cull_vec.clear();
+	frame.queryShapes(rect, 0, draw_object_cull_vec);
+	std::sort(draw_object_cull_vec.begin(), draw_object_cull_vec.end());
+	//shapes next to each other in a chunk are drawn with one call
+	std::size_t i = 0;
+	while (i < draw_object_cull_vec.size()) {
+		const PreparedFrame::VertexRange & first = frame.range_vec[draw_object_cull_vec[i]];
+		std::size_t vertex_end = first.end;
+		for (++i; i < draw_object_cull_vec.size(); ++i) {
+			const PreparedFrame::VertexRange & next = frame.range_vec[draw_object_cull_vec[i]];
+			if (next.chunk != first.chunk || next.begin != vertex_end) {
+				break;
+			}
+			vertex_end = next.end;
+		}
+		if (vertex_end > first.begin) {
+			window.draw(&(*frame.chunk_vec[first.chunk])[first.begin], vertex_end - first.begin, sf::Triangles);
+			stats.vertex_count += vertex_end - first.begin;
+		}
+	}
+	stats.drawn_shape_count += draw_object_cull_vec.size();
+}
+
+void Window::evictDrawObjectTiles(int level, const wykobi::rectangle<float> & view_rect) {
+	float view_width = view_rect[1].x - view_rect[0].x;
+	float view_height = view_rect[1].y - view_rect[0].y;
+	wykobi::rectangle<float> keep_rect = wykobi::make_rectangle(
+		view_rect[0].x - view_width, view_rect[0].y - view_height,
+		view_rect[1].x + view_width, view_rect[1].y + view_height
+	);
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> lru_vec;		//last used, key
+	for (auto it = draw_object_tile_map.begin(); it != draw_object_tile_map.end();) {
+		const DrawObjectTile & tile = it->second;
+		if (std::abs(tile.level - level) > 1 || !SpatialIndex::rectangleIntersect(getDrawObjectTileRectangle(tile.level, tile.x, tile.y), keep_rect)) {
+			draw_object_tile_cached_vertex_count -= tile.vertex_array.getVertexCount();
+			it = draw_object_tile_map.erase(it);
+			continue;
+		}
+		if (tile.last_used != draw_object_tile_frame) {
+			lru_vec.emplace_back(tile.last_used, it->first);
+		}
+		++it;
+	}
+	if (draw_object_tile_cached_vertex_count <= draw_object_tile_max_cached_vertex_count) {
+		return;
+	}
+	std::sort(lru_vec.begin(), lru_vec.end());
+	for (const std::pair<std::uint64_t, std::uint64_t> & lru : lru_vec) {
+		if (draw_object_tile_cached_vertex_count <= draw_object_tile_max_cached_vertex_count) {
+			break;
+		}
+		auto it = draw_object_tile_map.find(lru.second);
+		draw_object_tile_cached_vertex_count -= it->second.vertex_array.getVertexCount();
+		draw_object_tile_map.erase(it);
+	}
+}
+
+std::uint64_t Window::makeTileKey(int level, std::int32_t tile_x, std::int32_t tile_y) {
+	//9 bits of level and 27 bits of each coordinate, coordinates are within draw_object_tile_max_coordinate
+	const std::uint64_t coordinate_mask = (static_cast<std::uint64_t>(1) << 27) - 1;
+	return (static_cast<std::uint64_t>(level + 256) << 54) |
+		((static_cast<std::uint64_t>(static_cast<std::uint32_t>(tile_x)) & coordinate_mask) << 27) |
+		(static_cast<std::uint64_t>(static_cast<std::uint32_t>(tile_y)) & coordinate_mask);
+}
+
+wykobi::rectangle<float> Window::getWorldViewRectangle() {
+	sf::Vector2f centre = world_view.getCenter();
+	sf::Vector2f half_size = world_view.getSize() / 2.f;
+	return wykobi::make_rectangle(centre.x - half_size.x, centre.y - half_size.y, centre.x + half_size.x, centre.y + half_size.y);
+}
+
+bool Window::applySceneCommands() {
+	scene_command_vec.clear();
+	if (scene_command_queue.drain(scene_command_vec) == 0) {
+		return false;
+	}
+	bool removed = false;
+	for (SceneCommand & command : scene_command_vec) {
+		switch (command.type) {
+		case SceneCommand::Add:
+			//snap tree is only kept up to date while making polygons
+			if (m_make_polygon_mode && !snap_tree_stale) {
+				command.shape->appendCornerPoints(snap_pending_vec);
+			}
+			else {
+				snap_tree_stale = true;
+			}
+			draw_object_index_map[command.id] = draw_object_vec.size();
+			draw_object_spatial_index.insert(command.id, command.shape->getBoundingRectangle());
+			draw_object_vec.push_back(std::move(command.shape));
+			draw_object_id_vec.push_back(command.id);
+			break;
+		case SceneCommand::Update: {
+			auto it = draw_object_index_map.find(command.id);
+			if (it != draw_object_index_map.end()) {
+				draw_object_spatial_index.insert(command.id, command.shape->getBoundingRectangle());
+				draw_object_vec.set(it->second, std::move(command.shape));
+				snap_outline_index_map.erase(command.id);
+				++draw_object_rebuild_version;
+				snap_tree_stale = true;
+			}
+			break;
+		}
+		case SceneCommand::Remove: {
+			auto it = draw_object_index_map.find(command.id);
+			if (it != draw_object_index_map.end()) {
+				//leave a null entry so later indices stay valid, gaps are closed after the drain
+				draw_object_vec.set(it->second, nullptr);
+				draw_object_index_map.erase(it);
+				draw_object_spatial_index.remove(command.id);
+				snap_outline_index_map.erase(command.id);
+				removed = true;
+				++draw_object_rebuild_version;
+				snap_tree_stale = true;
+			}
+			break;
+		}
+		case SceneCommand::Clear:
+			draw_object_vec.clear();
+			draw_object_id_vec.clear();
+			draw_object_index_map.clear();
+			draw_object_spatial_index.clear();
+			snap_outline_index_map.clear();
+			++draw_object_rebuild_version;
+			snap_tree_stale = true;
+			break;
+		case SceneCommand::Restyle:
+			//shapes keep their class, only the entry drawn for it changes, prepare finds the chunks using it
+			if (style_class_map->resolve(command.restyle_from) != command.restyle_to) {
+				std::shared_ptr<StyleClassMap> restyled_map = std::make_shared<StyleClassMap>(*style_class_map);
+				restyled_map->set(command.restyle_from, command.restyle_to);
+				style_class_map = restyled_map;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	//one pass for all removes in the drain, draw order is kept
+	if (removed) {
+		std::size_t next = 0;
+		for (std::size_t i = 0; i < draw_object_vec.size(); ++i) {
+			if (!draw_object_vec[i]) {
+				continue;
+			}
+			if (next != i) {
+				draw_object_vec.set(next, draw_object_vec[i]);
+				draw_object_id_vec.set(next, draw_object_id_vec[i]);
+				draw_object_index_map[draw_object_id_vec[next]] = next;
+			}
+			++next;
+		}
+		draw_object_vec.truncate(next);
+		draw_object_id_vec.truncate(next);
+	}
+	publishDrawObjectSnapshot();
+	return true;
+}
+
+std::shared_ptr<const DrawObject> Window::makeStoredShape(std::shared_ptr<const DrawObject> shape) {
+	if (compact_storage) {
+		const PolygonShape* polygon_shape = dynamic_cast<const PolygonShape*>(shape.get());
+		if (polygon_shape != nullptr) {
+			std::shared_ptr<CompactPolygonShape> compact_shape = CompactPolygonShape::fromPolygonShape(*polygon_shape, QuantizedTiling::fromErrorBound(compact_storage_error_bound));
+			if (compact_shape) {
+				return compact_shape;
+			}
+		}
+	}
+	return shape;
+}
+
+void Window::publishDrawObjectSnapshot() {
+	std::shared_ptr<DrawObjectSnapshot> snapshot = std::make_shared<DrawObjectSnapshot>();
+	snapshot->draw_object_vec = draw_object_vec;
+	snapshot->id_vec = draw_object_id_vec;
+	snapshot->style_class_map = style_class_map;
+	snapshot->rebuild_version = draw_object_rebuild_version;
+	std::atomic_store(&draw_object_snapshot, std::shared_ptr<const DrawObjectSnapshot>(snapshot));
+	wakePrepThread();
+}
+
+std::shared_ptr<const DrawObjectSnapshot> Window::getDrawObjectSnapshot() {
+	return std::atomic_load(&draw_object_snapshot);
+}
+
+std::shared_ptr<const DrawObject> GeometryDisplay::resolveStyleClass(const std::shared_ptr<const DrawObject> & shape, const StyleClassMap & style_class_map) {
+	if (!style_class_map.isRestyled(shape->style_id)) {
+		return shape;
+	}
+	std::shared_ptr<DrawObject> copy(shape->clone());
+	copy->style_id = style_class_map.resolve(shape->style_id);
+	return copy;
+}
+
+const std::size_t PreparedFrame::chunk_vertex_count;
+
+std::shared_ptr<const PreparedFrame> PreparedFrame::prepare(std::shared_ptr<const DrawObjectSnapshot> snapshot, std::shared_ptr<const PreparedFrame> previous) {
+	FrameStatsRecorder::Clock::time_point begin = FrameStatsRecorder::Clock::now();
+	const ChunkedVector<std::shared_ptr<const DrawObject>> & draw_object_vec = snapshot->draw_object_vec;
+	const StyleClassMap & style_class_map = *snapshot->style_class_map;
+	std::shared_ptr<PreparedFrame> frame = std::make_shared<PreparedFrame>();
+	frame->snapshot = snapshot;
+	std::shared_ptr<sf::VertexArray> chunk;
+	std::shared_ptr<std::vector<StyleId>> chunk_class;
+	std::size_t append_begin = 0;
+	//shapes from previous are unchanged if only shapes were added or restyled, share their chunks
+	if (previous && previous->snapshot->rebuild_version == snapshot->rebuild_version && previous->range_vec.size() <= draw_object_vec.size()) {
+		append_begin = previous->range_vec.size();
+		frame->chunk_vec = previous->chunk_vec;
+		frame->chunk_begin_vec = previous->chunk_begin_vec;
+		frame->chunk_class_vec = previous->chunk_class_vec;
+		frame->range_vec = previous->range_vec;
+		frame->centroid_vec = previous->centroid_vec;
+		frame->bounding_rectangle_vec = previous->bounding_rectangle_vec;
+		frame->label_run_vec = previous->label_run_vec;
+		frame->index_run_vec = previous->index_run_vec;
+		frame->bounding_rectangle = previous->bounding_rectangle;
+		frame->vertex_count = previous->vertex_count;
+		//tessellate chunks using a restyled class again, O(chunks) to find them and no work for the other shapes
+		if (previous->snapshot->style_class_map != snapshot->style_class_map) {
+			std::vector<StyleId> changed_vec;
+			style_class_map.appendChanged(*previous->snapshot->style_class_map, changed_vec);
+			for (std::size_t c = 0; c < frame->chunk_vec.size() && !changed_vec.empty(); ++c) {
+				const std::vector<StyleId> & class_vec = *frame->chunk_class_vec[c];
+				bool restyled = std::find_first_of(class_vec.begin(), class_vec.end(), changed_vec.begin(), changed_vec.end()) != class_vec.end();
+				if (!restyled) {
+					continue;
+				}
+				std::size_t shape_end = (c + 1 < frame->chunk_begin_vec.size()) ? frame->chunk_begin_vec[c + 1] : append_begin;
+				std::shared_ptr<sf::VertexArray> restyled_chunk = std::make_shared<sf::VertexArray>(sf::Triangles);
+				for (std::size_t i = frame->chunk_begin_vec[c]; i < shape_end; ++i) {
+					const DrawObject & shape = *draw_object_vec[i];
+					VertexRange range;
+					range.chunk = c;
+					range.begin = restyled_chunk->getVertexCount();
+					shape.appendStyledVertex(*restyled_chunk, style_class_map.get(shape.style_id));
+					range.end = restyled_chunk->getVertexCount();
+					frame->range_vec.set(i, range);
+				}
+				frame->vertex_count = frame->vertex_count - frame->chunk_vec[c]->getVertexCount() + restyled_chunk->getVertexCount();
+				frame->chunk_vec[c] = restyled_chunk;
+			}
+		}
+		//last chunk may have room left, copy it instead of sharing
+		if (!frame->chunk_vec.empty() && frame->chunk_vec.back()->getVertexCount() < chunk_vertex_count) {
+			chunk = std::make_shared<sf::VertexArray>(*frame->chunk_vec.back());
+			chunk_class = std::make_shared<std::vector<StyleId>>(*frame->chunk_class_vec.back());
+			frame->chunk_vec.pop_back();
+			frame->chunk_class_vec.pop_back();
+		}
+	}
+	std::shared_ptr<std::vector<std::size_t>> label_run = std::make_shared<std::vector<std::size_t>>();
+	for (std::size_t i = append_begin; i < draw_object_vec.size(); ++i) {
+		if (!chunk || chunk->getVertexCount() >= chunk_vertex_count) {
+			if (chunk) {
+				frame->chunk_vec.push_back(chunk);
+				frame->chunk_class_vec.push_back(chunk_class);
+			}
+			chunk = std::make_shared<sf::VertexArray>(sf::Triangles);
+			chunk_class = std::make_shared<std::vector<StyleId>>();
+			frame->chunk_begin_vec.push_back(i);
+		}
+		const DrawObject & shape = *draw_object_vec[i];
+		VertexRange range;
+		range.chunk = frame->chunk_vec.size();
+		range.begin = chunk->getVertexCount();
+		shape.appendStyledVertex(*chunk, style_class_map.get(shape.style_id));
+		range.end = chunk->getVertexCount();
+		std::vector<StyleId>::iterator class_it = std::lower_bound(chunk_class->begin(), chunk_class->end(), shape.style_id);
+		if (class_it == chunk_class->end() || *class_it != shape.style_id) {
+			chunk_class->insert(class_it, shape.style_id);
+		}
+		frame->range_vec.push_back(range);
+		frame->vertex_count += range.end - range.begin;
+		frame->centroid_vec.push_back(shape.getCentroid());
+		wykobi::rectangle<float> rect = SpatialIndex::normalizeRectangle(shape.getBoundingRectangle());
+		frame->bounding_rectangle_vec.push_back(rect);
+		if (i == 0) {
+			frame->bounding_rectangle = rect;
+		}
+		else {
+			frame->bounding_rectangle[0].x = std::min(frame->bounding_rectangle[0].x, rect[0].x);
+			frame->bounding_rectangle[0].y = std::min(frame->bounding_rectangle[0].y, rect[0].y);
+			frame->bounding_rectangle[1].x = std::max(frame->bounding_rectangle[1].x, rect[1].x);
+			frame->bounding_rectangle[1].y = std::max(frame->bounding_rectangle[1].y, rect[1].y);
+		}
+		if (shape.name_id != 0) {
+			label_run->push_back(i);
+		}
+	}
+	if (chunk) {
+		frame->chunk_vec.push_back(chunk);
+		frame->chunk_class_vec.push_back(chunk_class);
+	}
+	//sort new labels into a run, then merge it with runs of previous until the run before it is more than twice its size
+	//so there are O(log n) runs, every label takes part in O(log n) merges, and runs of previous are shared until merged
+	if (!label_run->empty()) {
+		const PreparedFrame & sorted_frame = *frame;
+		auto label_before = [&sorted_frame](std::size_t a, std::size_t b) {
+			return sorted_frame.labelBefore(a, b);
+		};
+		std::sort(label_run->begin(), label_run->end(), label_before);
+		while (!frame->label_run_vec.empty() && frame->label_run_vec.back()->size() <= label_run->size() * 2) {
+			const std::vector<std::size_t> & last_run = *frame->label_run_vec.back();
+			std::shared_ptr<std::vector<std::size_t>> merged_run = std::make_shared<std::vector<std::size_t>>();
+			merged_run->reserve(last_run.size() + label_run->size());
+			std::merge(last_run.begin(), last_run.end(), label_run->begin(), label_run->end(), std::back_inserter(*merged_run), label_before);
+			label_run = std::move(merged_run);
+			frame->label_run_vec.pop_back();
+		}
+		frame->label_run_vec.push_back(label_run);
+	}
+	//index new shapes as a run, merged with runs of previous the same way as the label runs
+	if (append_begin < draw_object_vec.size()) {
+		ShapeIndexRun index_run;
+		index_run.begin = append_begin;
+		index_run.end = draw_object_vec.size();
+		while (!frame->index_run_vec.empty() && frame->index_run_vec.back().end - frame->index_run_vec.back().begin <= (index_run.end - index_run.begin) * 2) {
+			index_run.begin = frame->index_run_vec.back().begin;
+			frame->index_run_vec.pop_back();
+		}
+		std::shared_ptr<SpatialIndex> index = std::make_shared<SpatialIndex>();
+		for (std::size_t i = index_run.begin; i < index_run.end; ++i) {
+			index->insert(i, frame->bounding_rectangle_vec[i]);
+		}
+		index_run.index = index;
+		frame->index_run_vec.push_back(index_run);
+	}
+	frame->prepare_ms = std::chrono::duration<float, std::milli>(FrameStatsRecorder::Clock::now() - begin).count();
+	return frame;
+}
+
+bool PreparedFrame::labelBefore(std::size_t a, std::size_t b) const {
+	const wykobi::rectangle<float> & rect_a = bounding_rectangle_vec[a];
+	const wykobi::rectangle<float> & rect_b = bounding_rectangle_vec[b];
+	float area_a = (rect_a[1].x - rect_a[0].x) * (rect_a[1].y - rect_a[0].y);
+	float area_b = (rect_b[1].x - rect_b[0].x) * (rect_b[1].y - rect_b[0].y);
+	return area_a > area_b || (area_a == area_b && a < b);
+}
+
+void PreparedFrame::appendLabels(const wykobi::rectangle<float>* view_rect, std::vector<std::size_t> & out_vec) const {
+	auto label_before = [this](std::size_t a, std::size_t b) {
+		return labelBefore(a, b);
+	};
+	std::size_t out_begin = out_vec.size();
+	for (const std::shared_ptr<const std::vector<std::size_t>> & label_run : label_run_vec) {
+		std::size_t run_begin = out_vec.size();
+		for (std::size_t index : *label_run) {
+			if (view_rect == nullptr || SpatialIndex::rectangleIntersect(bounding_rectangle_vec[index], *view_rect)) {
+				out_vec.push_back(index);
+			}
+		}
+		std::inplace_merge(out_vec.begin() + out_begin, out_vec.begin() + run_begin, out_vec.end(), label_before);
+	}
+}
+
+void PreparedFrame::queryShapes(const wykobi::rectangle<float> & rect, std::size_t begin, std::vector<std::size_t> & out_vec) const {
+	for (const ShapeIndexRun & index_run : index_run_vec) {
+		if (index_run.end <= begin) {
+			continue;
+		}
+		if (index_run.begin >= begin) {
+			index_run.index->query(rect, out_vec);
+		}
+		else {
+			index_run.index->query(rect, [begin, &out_vec](std::size_t index) {
+				if (index >= begin) {
+					out_vec.push_back(index);
+				}
+				return true;
+			});
+		}
+	}
+}
+
+void Window::setDetectInstances(bool v) {
+	detect_instances = v;
+}
+
+void Window::setTileSize(float size) {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	if (size >= 0.f) {
+		//cached tiles of other levels are evicted when drawn
+		draw_object_tile_min_size = size;
+		requestFrame(InvalidateScene);
+	}
+}
+
+void Window::setCompactStorage(bool v, double error_bound) {
+	compact_storage_error_bound = error_bound;
+	compact_storage = v;
+}
+
+void Window::setTitle(std::string title) {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	window_title = title;
+	requestFrame(InvalidateUI);
+}
+
+void Window::setUpdateInterval(int t) {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	update_interval = t;
+	wake();
+}
+
+void Window::setWindowSize(int w, int h) {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	window_size = { static_cast<unsigned int>(w), static_cast<unsigned int>(h) };
+	requestFrame(InvalidateView | InvalidateUI);
+}
+
+void Window::setDiagramPosition(float x, float y) {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	world_view.setCenter(x + world_view.getSize().x / 2, y + world_view.getSize().y / 2);
+	requestFrame(InvalidateView);
+}
+
+void Window::setDiagramLineResolution(float x, float y) {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	auto_line_resolution = false;
+	diagram_line_resolution.x = x;
+	diagram_line_resolution.y = y;
+	diagram_major_line_ratio = { 1, 1 };
+	requestFrame(InvalidateView);
+}
+
+void Window::setAutoLineResolution(bool v) {
+	std::unique_lock<std::mutex> m_lock(window_mutex);
+	auto_line_resolution = v;
+	if (!v) {
+		diagram_major_line_ratio = { 1, 1 };
+	}
+	requestFrame(InvalidateView);
+}
+
+ShapeId Window::addShape(DrawObject & shape) {
+	ShapeId id = next_shape_id++;
+	pushSceneCommand({ SceneCommand::Add, id, makeStoredShape(std::shared_ptr<const DrawObject>(shape.clone())) });
+	return id;
+}
+
+ShapeId Window::addShape(std::unique_ptr<DrawObject> & ptr) {
+	ShapeId id = next_shape_id++;
+	pushSceneCommand({ SceneCommand::Add, id, makeStoredShape(std::shared_ptr<const DrawObject>(std::move(ptr))) });
+	return id;
+}
+
+ShapeId Window::addShape(wykobi::polygon<float, 2> poly) {
+	PolygonShape shape(poly);
+	return addShape(shape);
+}
+
+ShapeId Window::addShape(wykobi::segment<float, 2> seg) {
+	LineShape shape(seg);
+	return addShape(shape);
+}
+
+void Window::updateShape(ShapeId id, DrawObject & shape) {
+	pushSceneCommand({ SceneCommand::Update, id, makeStoredShape(std::shared_ptr<const DrawObject>(shape.clone())) });
+}
+
+void Window::removeShape(ShapeId id) {
+	pushSceneCommand({ SceneCommand::Remove, id, nullptr });
+}
+
+void Window::setStyle(StyleId id, const DrawStyle & style) {
+	if (id == 0) {
+		std::cout << "Error: style 0 can not be changed\n";
+		return;
+	}
+	SceneCommand command = { SceneCommand::Restyle, 0, nullptr };
+	command.restyle_from = id;
+	command.restyle_to = StyleTable::intern(style);
+	pushSceneCommand(std::move(command));
 }
 
 sf::Vector2u Window::getWindowSize() {
@@ -990,16 +2305,37 @@ sf::Vector2u Window::getWindowSize() {
 }
 
 void Window::clearShapeVec() {
-	std::unique_lock<std::mutex> m_lock(draw_object_vec_mutex);
-	draw_object_vec.clear();
-	update_frame = true;
+	pushSceneCommand({ SceneCommand::Clear, 0, nullptr });
 }
 
 void Window::close() {
 	running = false;
+	wake();
 	join();
 }
 
+void Window::wake() {
+	//only the first wake since window_thread last woke up takes the mutex
+	if (!wake_pending.exchange(true)) {
+		std::unique_lock<std::mutex> m_lock(wake_mutex);
+		wake_condition.notify_one();
+	}
+}
+
+void Window::invalidate(unsigned int flags) {
+	invalidation |= flags;
+}
+
+void Window::requestFrame(unsigned int flags) {
+	invalidate(flags);
+	wake();
+}
+
+void Window::pushSceneCommand(SceneCommand command) {
+	scene_command_queue.push(std::move(command));
+	wake();
+}
+
 void Window::join() {
 	if (window_thread.joinable()) {
 		window_thread.join();
@@ -1010,182 +2346,674 @@ PolygonShape::PolygonShape(wykobi::polygon<float, 2> poly) {
 	polygon = poly;
 }
 
-PolygonShape* GeometryDisplay::PolygonShape::clone() {
+PolygonShape* GeometryDisplay::PolygonShape::clone() const {
 	return new PolygonShape(*this);
 }
 
-sf::Vector2f PolygonShape::getCentroid() {
-	auto centre = wykobi::centroid(polygon);
-	return { centre.x, centre.y };
+sf::Vector2f PolygonShape::getCentroid() const {
+	auto centre = wykobi::centroid(polygon);
+	return { centre.x, centre.y };
+}
+
+wykobi::rectangle<float> PolygonShape::getBoundingRectangle() const {
+	return GeometryDisplay::getBoundingRectangle(polygon);
+}
+
+void PolygonShape::appendStyledVertex(sf::VertexArray & vertex_arr, const DrawStyle & style) const {
+	if (style.inner_fill) {
+		std::vector<wykobi::triangle<float, 2>> triangle_vec;
+		wykobi::algorithm::polygon_triangulate<wykobi::point2d<float>>(polygon, std::back_inserter(triangle_vec));
+		for (wykobi::triangle<float, 2> & tri : triangle_vec) {
+			for (std::size_t i = 0; i < tri.size(); ++i) {
+				sf::Vertex v;
+				v.position = sf::Vector2f(tri[i].x, tri[i].y);
+				v.color = style.fill_color;
+				vertex_arr.append(v);
+			}
+		}
+	}
+	if (style.outer_line) {
+		for (std::size_t i = 0; i < polygon.size(); ++i) {
+			wykobi::segment<float, 2> seg = wykobi::edge(polygon, i);
+			for (wykobi::triangle<float, 2> & tri : makeTriangleLine(seg, style.outer_line_thickness)) {
+				for (std::size_t j = 0; j < tri.size(); ++j) {
+					sf::Vertex v;
+					v.position = sf::Vector2f(tri[j].x, tri[j].y);
+					v.color = style.line_color;
+					vertex_arr.append(v);
+				}
+			}
+		}
+	}
+}
+
+void PolygonShape::writeStyledSvg(std::ostream & out, const DrawStyle & style, sf::Vector2f offset) const {
+	writeSvgPolygon(out, polygon, style, offset);
+}
+
+bool PolygonShape::containsStyledPoint(sf::Vector2f point, const DrawStyle & style, float tolerance) const {
+	if (style.inner_fill && pointInsidePolygon(point, polygon)) {
+		return true;
+	}
+	if (style.outer_line) {
+		float max_distance = style.outer_line_thickness / 2.f + tolerance;
+		for (std::size_t i = 0; i < polygon.size(); ++i) {
+			if (pointSegmentDistance(point, wykobi::edge(polygon, i)) <= max_distance) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool PolygonShape::intersectsPolygon(const wykobi::polygon<float, 2> & region) const {
+	return polygonIntersectPolygon(polygon, region);
+}
+
+void PolygonShape::appendCornerPoints(std::vector<sf::Vector2f> & out_vec) const {
+	for (std::size_t i = 0; i < polygon.size(); ++i) {
+		out_vec.push_back({ polygon[i].x, polygon[i].y });
+	}
+}
+
+float PolygonShape::closestOutlinePoint(sf::Vector2f point, sf::Vector2f & out_point) const {
+	float best_distance = std::numeric_limits<float>::infinity();
+	for (std::size_t i = 0; i < polygon.size(); ++i) {
+		sf::Vector2f p = closestSegmentPoint(point, wykobi::edge(polygon, i));
+		sf::Vector2f e = p - point;
+		float distance = std::sqrt(e.x * e.x + e.y * e.y);
+		if (distance < best_distance) {
+			best_distance = distance;
+			out_point = p;
+		}
+	}
+	return best_distance;
+}
+
+void PolygonShape::appendOutlineSegments(std::vector<wykobi::segment<float, 2>> & out_vec) const {
+	for (std::size_t i = 0; i < polygon.size(); ++i) {
+		out_vec.push_back(wykobi::edge(polygon, i));
+	}
+}
+
+DrawObject::DrawObject(std::unordered_map<std::string, std::string> & settings_map) {
+	std::unordered_map<std::string, std::string>::iterator it;
+	it = settings_map.find("name");
+	if (it != settings_map.end()) {
+		name_id = NamePool::intern(it->second);
+	}
+	style_id = StyleTable::intern(parseStyle(settings_map, DrawStyle()));
+}
+
+DrawStyle DrawObject::parseStyle(std::unordered_map<std::string, std::string> & settings_map, DrawStyle style) {
+	std::unordered_map<std::string, std::string>::iterator it;
+	it = settings_map.find("outer_line");
+	if (it != settings_map.end()) {
+		std::istringstream(it->second) >> style.outer_line;
+	}
+	it = settings_map.find("line_color");
+	if (it != settings_map.end()) {
+		style.line_color = parseColor(it->second);
+	}
+	it = settings_map.find("outer_line_thickness");
+	if (it != settings_map.end()) {
+		style.outer_line_thickness = static_cast<float>(std::atof(it->second.c_str()));
+	}
+	it = settings_map.find("inner_fill");
+	if (it != settings_map.end()) {
+		std::istringstream(it->second) >> style.inner_fill;
+	}
+	it = settings_map.find("fill_color");
+	if (it != settings_map.end()) {
+		style.fill_color = parseColor(it->second);
+	}
+	return style;
+}
+
+std::string DrawObject::toString() const {
+	std::ostringstream stream;
+	DrawStyle style = getStyle();
+	if (name_id != 0) {
+		stream << "name=" << getName() << " ";
+	}
+	//flags are always written, so styles that differ from the defaults read back the same
+	stream << "outer_line=" << style.outer_line << " ";
+	if (style.outer_line) {
+		if (style.line_color.a != 0xff) {
+			stream << "line_color=" << std::hex << style.line_color.toInteger() << std::hex << style.line_color.a << " ";
+		}
+		else {
+			stream << "line_color=" << std::hex << style.line_color.toInteger() << " ";
+		}
+		stream << "outer_line_thickness=" << style.outer_line_thickness << " ";
+	}
+	stream << "inner_fill=" << style.inner_fill << " ";
+	if (style.inner_fill) {
+		if (style.fill_color.a != 0xff) {
+			stream << "fill_color=" << std::hex << style.fill_color.toInteger() << std::hex << style.fill_color.a << " ";
+		}
+		else {
+			stream << "fill_color=" << std::hex << style.fill_color.toInteger() << " ";
+		}
+	}
+	return stream.str();
+}
+
+void DrawObject::appendVertex(sf::VertexArray & vertex_arr) const {
+	appendStyledVertex(vertex_arr, getStyle());
+}
+
+bool DrawObject::containsPoint(sf::Vector2f point, float tolerance) const {
+	return containsStyledPoint(point, getStyle(), tolerance);
+}
+
+const std::string & DrawObject::getName() const {
+	return NamePool::get(name_id);
+}
+
+void DrawObject::setName(const std::string & name) {
+	name_id = NamePool::intern(name);
+}
+
+DrawStyle DrawObject::getStyle() const {
+	return StyleTable::get(style_id);
+}
+
+void DrawObject::setStyle(const DrawStyle & style) {
+	style_id = StyleTable::intern(style);
+}
+
+void DrawObject::setInnerFill(bool v) {
+	DrawStyle style = getStyle();
+	style.inner_fill = v;
+	setStyle(style);
+}
+
+void DrawObject::setOuterLine(bool v) {
+	DrawStyle style = getStyle();
+	style.outer_line = v;
+	setStyle(style);
+}
+
+void DrawObject::setFillColor(sf::Color color) {
+	DrawStyle style = getStyle();
+	style.fill_color = color;
+	setStyle(style);
+}
+
+void DrawObject::setLineColor(sf::Color color) {
+	DrawStyle style = getStyle();
+	style.line_color = color;
+	setStyle(style);
+}
+
+void DrawObject::setOuterLineThickness(float thickness) {
+	DrawStyle style = getStyle();
+	style.outer_line_thickness = thickness;
+	setStyle(style);
+}
+
+PolygonShape::PolygonShape(std::unordered_map<std::string, std::string> & settings_map)
+	: DrawObject(settings_map)
+{
+	std::unordered_map<std::string, std::string>::iterator it;
+	it = settings_map.find("polygon");
+	if (it != settings_map.end()) {
+		polygon = wykobi::make_polygon(parsePoints(it->second));
+	}
+}
+
+std::string PolygonShape::toString() const {
+	std::ostringstream stream;
+	stream << "type=" << "polygon" << " ";
+	stream << DrawObject::toString();
+	stream << "polygon={";
+	for (std::size_t i = 0; i < polygon.size(); ++i) {
+		stream << "(" << polygon[i].x << "," << polygon[i].y << ")";
+	}
+	stream << "}";
+	stream << " ";
+	return stream.str();
+}
+
+LineShape::LineShape(wykobi::segment<float, 2> seg) {
+	segment = seg;
+}
+
+LineShape* LineShape::clone() const {
+	return new LineShape(*this);
+}
+
+void LineShape::appendStyledVertex(sf::VertexArray & vertex_arr, const DrawStyle & style) const {
+	if (style.inner_fill) {
+		for (wykobi::triangle<float, 2> & tri : makeTriangleLine(segment, thickness)) {
+			for (std::size_t i = 0; i < tri.size(); ++i) {
+				sf::Vertex v;
+				v.position = sf::Vector2f(tri[i].x, tri[i].y);
+				v.color = style.fill_color;
+				vertex_arr.append(v);
+			}
+		}
+	}
+}
+
+void LineShape::writeStyledSvg(std::ostream & out, const DrawStyle & style, sf::Vector2f offset) const {
+	//lines are drawn with the fill color, same as appendStyledVertex
+	if (!style.inner_fill) {
+		return;
+	}
+	out << "<path d=\"M" << segment[0].x + offset.x << ' ' << segment[0].y + offset.y;
+	out << 'L' << segment[1].x + offset.x << ' ' << segment[1].y + offset.y << "\" fill=\"none\"";
+	writeSvgPaint(out, "stroke", style.fill_color);
+	out << " stroke-width=\"" << thickness << "\"/>\n";
+}
+
+bool LineShape::containsStyledPoint(sf::Vector2f point, const DrawStyle & style, float tolerance) const {
+	return style.inner_fill && pointSegmentDistance(point, segment) <= thickness / 2.f + tolerance;
+}
+
+bool LineShape::intersectsPolygon(const wykobi::polygon<float, 2> & region) const {
+	if (pointInsidePolygon({ segment[0].x, segment[0].y }, region)) {
+		return true;
+	}
+	for (std::size_t i = 0; i < region.size(); ++i) {
+		if (wykobi::intersect(wykobi::edge(region, i), segment)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void LineShape::appendCornerPoints(std::vector<sf::Vector2f> & out_vec) const {
+	out_vec.push_back({ segment[0].x, segment[0].y });
+	out_vec.push_back({ segment[1].x, segment[1].y });
+}
+
+float LineShape::closestOutlinePoint(sf::Vector2f point, sf::Vector2f & out_point) const {
+	out_point = closestSegmentPoint(point, segment);
+	sf::Vector2f e = out_point - point;
+	return std::sqrt(e.x * e.x + e.y * e.y);
+}
+
+void LineShape::appendOutlineSegments(std::vector<wykobi::segment<float, 2>> & out_vec) const {
+	out_vec.push_back(segment);
+}
+
+LineShape::LineShape(std::unordered_map<std::string, std::string> & settings_map) 
+	: DrawObject(settings_map)
+{
+	std::unordered_map<std::string, std::string>::iterator it;
+	it = settings_map.find("thickness");
+	if (it != settings_map.end()) {
+		thickness = (float)std::atof(it->second.c_str());
+	}
+	it = settings_map.find("segment");
+	if (it != settings_map.end()) {
+		auto point_vec = parsePoints(it->second);
+		segment = wykobi::make_segment(point_vec[0], point_vec[1]);
+	}
+}
+
+std::string LineShape::toString() const {
+	std::ostringstream stream;
+	stream << "type=" << "line" << " ";
+	stream << DrawObject::toString();
+	stream << "thickness=" << thickness << " ";
+	stream << "segment={";
+	for (std::size_t i = 0; i < segment.size(); ++i) {
+		stream << "(" << segment[i].x << "," << segment[i].y << ")";
+	}
+	stream << "}";
+	stream << " ";
+	return stream.str();
+}
+
+sf::Vector2f LineShape::getCentroid() const {
+	auto mid = wykobi::segment_mid_point(segment);
+	return { mid.x, mid.y };
+}
+
+wykobi::rectangle<float> LineShape::getBoundingRectangle() const {
+	return wykobi::make_rectangle(segment[0], segment[1]);
+}
+
+QuantizedTiling QuantizedTiling::fromErrorBound(double error_bound) {
+	QuantizedTiling tiling;
+	//rounding error is at most step / 2 on both axes at once, which is step / sqrt(2) in distance
+	tiling.step = error_bound * std::sqrt(2.0);
+	return tiling;
+}
+
+double QuantizedTiling::tileSize() const {
+	return step * 32768.0;
+}
+
+std::int32_t QuantizedTiling::tileIndex(double v) const {
+	return static_cast<std::int32_t>(std::floor(v / tileSize()));
+}
+
+double QuantizedTiling::tileOrigin(std::int32_t index) const {
+	return static_cast<double>(index) * tileSize();
+}
+
+std::shared_ptr<CompactPolygonShape> CompactPolygonShape::fromPolygonShape(const PolygonShape & shape, QuantizedTiling tiling) {
+	if (shape.polygon.size() == 0 || !(tiling.step > 0.0)) {
+		return nullptr;
+	}
+	std::shared_ptr<CompactPolygonShape> compact_shape = std::make_shared<CompactPolygonShape>();
+	compact_shape->name_id = shape.name_id;
+	compact_shape->style_id = shape.style_id;
+	compact_shape->tiling = tiling;
+	wykobi::rectangle<float> rect = shape.getBoundingRectangle();
+	compact_shape->tile_x = tiling.tileIndex(rect[0].x);
+	compact_shape->tile_y = tiling.tileIndex(rect[0].y);
+	double origin_x = tiling.tileOrigin(compact_shape->tile_x);
+	double origin_y = tiling.tileOrigin(compact_shape->tile_y);
+	//float decoding rounds again, far from the origin that can push a vertex past the bound
+	double max_error_sq = tiling.step * tiling.step / 2.0;
+	compact_shape->vertex_vec.reserve(shape.polygon.size());
+	for (std::size_t i = 0; i < shape.polygon.size(); ++i) {
+		double x = std::round((shape.polygon[i].x - origin_x) / tiling.step);
+		double y = std::round((shape.polygon[i].y - origin_y) / tiling.step);
+		if (x < 0.0 || y < 0.0 || x > 65535.0 || y > 65535.0) {
+			return nullptr;
+		}
+		double error_x = static_cast<double>(static_cast<float>(origin_x + x * tiling.step)) - shape.polygon[i].x;
+		double error_y = static_cast<double>(static_cast<float>(origin_y + y * tiling.step)) - shape.polygon[i].y;
+		if (error_x * error_x + error_y * error_y > max_error_sq) {
+			return nullptr;
+		}
+		compact_shape->vertex_vec.push_back({ static_cast<std::uint16_t>(x), static_cast<std::uint16_t>(y) });
+	}
+	return compact_shape;
+}
+
+wykobi::polygon<float, 2> CompactPolygonShape::decodePolygon() const {
+	wykobi::polygon<float, 2> poly;
+	decodePolygon(poly);
+	return poly;
+}
+
+void CompactPolygonShape::decodePolygon(wykobi::polygon<float, 2> & out_poly) const {
+	double origin_x = tiling.tileOrigin(tile_x);
+	double origin_y = tiling.tileOrigin(tile_y);
+	out_poly.clear();
+	out_poly.reserve(vertex_vec.size());
+	for (const std::array<std::uint16_t, 2> & v : vertex_vec) {
+		out_poly.push_back(wykobi::make_point<float>(
+			static_cast<float>(origin_x + v[0] * tiling.step),
+			static_cast<float>(origin_y + v[1] * tiling.step)
+		));
+	}
+}
+
+const PolygonShape & CompactPolygonShape::decodeShape() const {
+	static thread_local PolygonShape shape{ wykobi::polygon<float, 2>() };
+	decodePolygon(shape.polygon);
+	return shape;
+}
+
+CompactPolygonShape* CompactPolygonShape::clone() const {
+	return new CompactPolygonShape(*this);
+}
+
+sf::Vector2f CompactPolygonShape::getCentroid() const {
+	return decodeShape().getCentroid();
+}
+
+wykobi::rectangle<float> CompactPolygonShape::getBoundingRectangle() const {
+	//bounds of the steps decode to the same floats as the bounds of the decoded polygon
+	std::array<std::uint16_t, 2> low = { { 65535, 65535 } };
+	std::array<std::uint16_t, 2> high = { { 0, 0 } };
+	for (const std::array<std::uint16_t, 2> & v : vertex_vec) {
+		low[0] = std::min(low[0], v[0]);
+		low[1] = std::min(low[1], v[1]);
+		high[0] = std::max(high[0], v[0]);
+		high[1] = std::max(high[1], v[1]);
+	}
+	double origin_x = tiling.tileOrigin(tile_x);
+	double origin_y = tiling.tileOrigin(tile_y);
+	return wykobi::make_rectangle<float>(
+		static_cast<float>(origin_x + low[0] * tiling.step), static_cast<float>(origin_y + low[1] * tiling.step),
+		static_cast<float>(origin_x + high[0] * tiling.step), static_cast<float>(origin_y + high[1] * tiling.step)
+	);
+}
+
+void CompactPolygonShape::appendStyledVertex(sf::VertexArray & vertex_arr, const DrawStyle & style) const {
+	decodeShape().appendStyledVertex(vertex_arr, style);
+}
+
+void CompactPolygonShape::writeStyledSvg(std::ostream & out, const DrawStyle & style, sf::Vector2f offset) const {
+	writeSvgPolygon(out, decodeShape().polygon, style, offset);
+}
+
+bool CompactPolygonShape::containsStyledPoint(sf::Vector2f point, const DrawStyle & style, float tolerance) const {
+	return decodeShape().containsStyledPoint(point, style, tolerance);
+}
+
+bool CompactPolygonShape::intersectsPolygon(const wykobi::polygon<float, 2> & region) const {
+	return polygonIntersectPolygon(decodeShape().polygon, region);
+}
+
+void CompactPolygonShape::appendCornerPoints(std::vector<sf::Vector2f> & out_vec) const {
+	decodeShape().appendCornerPoints(out_vec);
+}
+
+float CompactPolygonShape::closestOutlinePoint(sf::Vector2f point, sf::Vector2f & out_point) const {
+	return decodeShape().closestOutlinePoint(point, out_point);
+}
+
+void CompactPolygonShape::appendOutlineSegments(std::vector<wykobi::segment<float, 2>> & out_vec) const {
+	decodeShape().appendOutlineSegments(out_vec);
+}
+
+std::string CompactPolygonShape::toString() const {
+	PolygonShape shape(decodePolygon());
+	shape.name_id = name_id;
+	shape.style_id = style_id;
+	return shape.toString();
+}
+
+ShapePrototype::ShapePrototype(std::shared_ptr<const DrawObject> prototype_shape) :
+	shape(prototype_shape)
+{
+	static std::atomic<std::size_t> next_id(0);
+	id = next_id++;
+	//tessellate fill and outline apart, instance colors are applied in InstanceShape::appendStyledVertex
+	DrawStyle style = shape->getStyle();
+	style.inner_fill = true;
+	style.outer_line = false;
+	sf::VertexArray fill_array(sf::Triangles);
+	shape->appendStyledVertex(fill_array, style);
+	fill_vertex_vec.resize(fill_array.getVertexCount());
+	for (std::size_t i = 0; i < fill_vertex_vec.size(); ++i) {
+		fill_vertex_vec[i] = fill_array[i];
+	}
+	line_thickness = style.outer_line_thickness;
+	tessellateLine(line_thickness, line_vertex_vec);
+	bounding_rectangle = shape->getBoundingRectangle();
+	centroid = shape->getCentroid();
+}
+
+const std::vector<sf::Vertex> & ShapePrototype::getLineVertex(float thickness) const {
+	if (thickness == line_thickness) {
+		return line_vertex_vec;
+	}
+	std::unique_lock<std::mutex> m_lock(line_mutex);
+	auto it = line_vertex_map.find(thickness);
+	if (it == line_vertex_map.end()) {
+		it = line_vertex_map.emplace(thickness, std::vector<sf::Vertex>()).first;
+		tessellateLine(thickness, it->second);
+	}
+	//map nodes never move, so the reference outlives the lock
+	return it->second;
+}
+
+void ShapePrototype::tessellateLine(float thickness, std::vector<sf::Vertex> & out_vec) const {
+	DrawStyle style = shape->getStyle();
+	style.inner_fill = false;
+	style.outer_line = true;
+	style.outer_line_thickness = thickness;
+	sf::VertexArray line_array(sf::Triangles);
+	shape->appendStyledVertex(line_array, style);
+	out_vec.resize(line_array.getVertexCount());
+	for (std::size_t i = 0; i < out_vec.size(); ++i) {
+		out_vec[i] = line_array[i];
+	}
+}
+
+std::string ShapePrototype::getName() const {
+	std::ostringstream stream;
+	stream << "p" << id;
+	return stream.str();
 }
 
-wykobi::rectangle<float> PolygonShape::getBoundingRectangle() {
-	return GeometryDisplay::getBoundingRectangle(polygon);
+std::string ShapePrototype::toString() const {
+	std::ostringstream stream;
+	stream << shape->toString();
+	stream << "define_prototype=" << getName() << " ";
+	return stream.str();
 }
 
-void PolygonShape::appendVertex(sf::VertexArray & vertex_arr) {
-	if (inner_fill) {
-		std::vector<wykobi::triangle<float, 2>> triangle_vec;
-		wykobi::algorithm::polygon_triangulate<wykobi::point2d<float>>(polygon, std::back_inserter(triangle_vec));
-		for (wykobi::triangle<float, 2> & tri : triangle_vec) {
-			for (std::size_t i = 0; i < tri.size(); ++i) {
-				sf::Vertex v;
-				v.position = sf::Vector2f(tri[i].x, tri[i].y);
-				v.color = fill_color;
-				vertex_arr.append(v);
-			}
-		}
-	}
-	if (outer_line) {
-		for (std::size_t i = 0; i < polygon.size(); ++i) {
-			wykobi::segment<float, 2> seg = wykobi::edge(polygon, i);
-			for (wykobi::triangle<float, 2> & tri : makeTriangleLine(seg, outer_line_thickness)) {
-				for (std::size_t j = 0; j < tri.size(); ++j) {
-					sf::Vertex v;
-					v.position = sf::Vector2f(tri[j].x, tri[j].y);
-					v.color = line_color;
-					vertex_arr.append(v);
-				}
-			}
-		}
-	}
+InstanceShape::InstanceShape(std::shared_ptr<const ShapePrototype> proto, sf::Vector2f instance_offset) :
+	DrawObject(*proto->shape),
+	prototype(proto),
+	offset(instance_offset)
+{
+	name_id = 0;
 }
 
-DrawObject::DrawObject(std::unordered_map<std::string, std::string> & settings_map) {
+InstanceShape::InstanceShape(std::unordered_map<std::string, std::string> & settings_map, std::shared_ptr<const ShapePrototype> proto) :
+	InstanceShape(proto, { 0.f, 0.f })
+{
 	std::unordered_map<std::string, std::string>::iterator it;
 	it = settings_map.find("name");
 	if (it != settings_map.end()) {
-		name = it->second;
-	}
-	it = settings_map.find("outer_line");
-	if (it != settings_map.end()) {
-		std::istringstream(it->second) >> outer_line;
-	}
-	it = settings_map.find("line_color");
-	if (it != settings_map.end()) {
-		line_color = parseColor(it->second);
-	}
-	it = settings_map.find("outer_line_thickness");
-	if (it != settings_map.end()) {
-		outer_line_thickness = static_cast<float>(std::atof(it->second.c_str()));
-	}
-	it = settings_map.find("inner_fill");
-	if (it != settings_map.end()) {
-		std::istringstream(it->second) >> inner_fill;
+		name_id = NamePool::intern(it->second);
 	}
-	it = settings_map.find("fill_color");
+	//attributes missing from the line keep the style of the prototype
+	style_id = StyleTable::intern(parseStyle(settings_map, getStyle()));
+	it = settings_map.find("offset");
 	if (it != settings_map.end()) {
-		fill_color = parseColor(it->second);
+		wykobi::point2d<float> p = parsePoint(it->second);
+		offset = { p.x, p.y };
 	}
 }
 
-std::string DrawObject::toString() {
-	std::ostringstream stream;
-	if (!name.empty()) {
-		stream << "name=" << name << " ";
+InstanceShape* InstanceShape::clone() const {
+	return new InstanceShape(*this);
+}
+
+sf::Vector2f InstanceShape::getCentroid() const {
+	return prototype->centroid + offset;
+}
+
+wykobi::rectangle<float> InstanceShape::getBoundingRectangle() const {
+	wykobi::rectangle<float> rect = prototype->bounding_rectangle;
+	for (std::size_t i = 0; i < rect.size(); ++i) {
+		rect[i].x += offset.x;
+		rect[i].y += offset.y;
 	}
-	if (outer_line) {
-		stream << "outer_line=" << outer_line << " ";
-		if (line_color.a != 0xff) {
-			stream << "line_color=" << std::hex << line_color.toInteger() << std::hex << line_color.a << " ";
-		}
-		else {
-			stream << "line_color=" << std::hex << line_color.toInteger() << " ";
+	return rect;
+}
+
+void InstanceShape::appendStyledVertex(sf::VertexArray & vertex_arr, const DrawStyle & style) const {
+	if (style.inner_fill) {
+		for (const sf::Vertex & prototype_vertex : prototype->fill_vertex_vec) {
+			vertex_arr.append(sf::Vertex(prototype_vertex.position + offset, style.fill_color));
 		}
-		stream << "outer_line_thickness=" << outer_line_thickness << " ";
 	}
-	if (inner_fill) {
-		stream << "inner_fill=" << inner_fill << " ";
-		if (fill_color.a != 0xff) {
-			stream << "fill_color=" << std::hex << fill_color.toInteger() << std::hex << fill_color.a << " ";
-		}
-		else {
-			stream << "fill_color=" << std::hex << fill_color.toInteger() << " ";
+	if (style.outer_line) {
+		for (const sf::Vertex & prototype_vertex : prototype->getLineVertex(style.outer_line_thickness)) {
+			vertex_arr.append(sf::Vertex(prototype_vertex.position + offset, style.line_color));
 		}
 	}
-	return stream.str();
 }
 
-PolygonShape::PolygonShape(std::unordered_map<std::string, std::string> & settings_map)
-	: DrawObject(settings_map)
-{
-	std::unordered_map<std::string, std::string>::iterator it;
-	it = settings_map.find("polygon");
-	if (it != settings_map.end()) {
-		polygon = wykobi::make_polygon(parsePoints(it->second));
-	}
+void InstanceShape::writeStyledSvg(std::ostream & out, const DrawStyle & style, sf::Vector2f offset) const {
+	prototype->shape->writeStyledSvg(out, style, offset + this->offset);
 }
 
-std::string PolygonShape::toString() {
-	std::ostringstream stream;
-	stream << "type=" << "polygon" << " ";
-	stream << DrawObject::toString();
-	stream << "polygon={";
-	for (std::size_t i = 0; i < polygon.size(); ++i) {
-		stream << "(" << polygon[i].x << "," << polygon[i].y << ")";
-	}
-	stream << "}";
-	stream << " ";
-	return stream.str();
+bool InstanceShape::containsStyledPoint(sf::Vector2f point, const DrawStyle & style, float tolerance) const {
+	return prototype->shape->containsStyledPoint(point - offset, style, tolerance);
 }
 
-LineShape::LineShape(wykobi::segment<float, 2> seg) {
-	segment = seg;
+bool InstanceShape::intersectsPolygon(const wykobi::polygon<float, 2> & region) const {
+	wykobi::polygon<float, 2> local_region = region;
+	for (std::size_t i = 0; i < local_region.size(); ++i) {
+		local_region[i].x -= offset.x;
+		local_region[i].y -= offset.y;
+	}
+	return prototype->shape->intersectsPolygon(local_region);
 }
 
-LineShape* LineShape::clone() {
-	return new LineShape(*this);
+void InstanceShape::appendCornerPoints(std::vector<sf::Vector2f> & out_vec) const {
+	std::size_t begin = out_vec.size();
+	prototype->shape->appendCornerPoints(out_vec);
+	for (std::size_t i = begin; i < out_vec.size(); ++i) {
+		out_vec[i] += offset;
+	}
 }
 
-void LineShape::appendVertex(sf::VertexArray & vertex_arr) {
-	if (inner_fill) {
-		for (wykobi::triangle<float, 2> & tri : makeTriangleLine(segment, thickness)) {
-			for (std::size_t i = 0; i < tri.size(); ++i) {
-				sf::Vertex v;
-				v.position = sf::Vector2f(tri[i].x, tri[i].y);
-				v.color = fill_color;
-				vertex_arr.append(v);
-			}
-		}
-	}
+float InstanceShape::closestOutlinePoint(sf::Vector2f point, sf::Vector2f & out_point) const {
+	float distance = prototype->shape->closestOutlinePoint(point - offset, out_point);
+	out_point += offset;
+	return distance;
 }
 
-LineShape::LineShape(std::unordered_map<std::string, std::string> & settings_map) 
-	: DrawObject(settings_map)
-{
-	std::unordered_map<std::string, std::string>::iterator it;
-	it = settings_map.find("thickness");
-	if (it != settings_map.end()) {
-		thickness = (float)std::atof(it->second.c_str());
-	}
-	it = settings_map.find("segment");
-	if (it != settings_map.end()) {
-		auto point_vec = parsePoints(it->second);
-		segment = wykobi::make_segment(point_vec[0], point_vec[1]);
+void InstanceShape::appendOutlineSegments(std::vector<wykobi::segment<float, 2>> & out_vec) const {
+	std::size_t begin = out_vec.size();
+	prototype->shape->appendOutlineSegments(out_vec);
+	for (std::size_t i = begin; i < out_vec.size(); ++i) {
+		for (std::size_t j = 0; j < out_vec[i].size(); ++j) {
+			out_vec[i][j].x += offset.x;
+			out_vec[i][j].y += offset.y;
+		}
 	}
 }
 
-std::string LineShape::toString() {
+std::string InstanceShape::toString() const {
 	std::ostringstream stream;
-	stream << "type=" << "line" << " ";
+	stream << "type=" << "instance" << " ";
 	stream << DrawObject::toString();
-	stream << "thickness=" << thickness << " ";
-	stream << "segment={";
-	for (std::size_t i = 0; i < segment.size(); ++i) {
-		stream << "(" << segment[i].x << "," << segment[i].y << ")";
-	}
-	stream << "}";
+	stream << "prototype=" << prototype->getName() << " ";
+	stream << "offset=(" << offset.x << "," << offset.y << ")";
 	stream << " ";
 	return stream.str();
 }
 
-sf::Vector2f LineShape::getCentroid() {
-	auto mid = wykobi::segment_mid_point(segment);
-	return { mid.x, mid.x };
+void GeometryDisplay::writeSvgPaint(std::ostream & out, const char* name, sf::Color color) {
+	static const char digit_arr[] = "0123456789abcdef";
+	out << ' ' << name << "=\"#";
+	for (sf::Uint8 c : { color.r, color.g, color.b }) {
+		out << digit_arr[c >> 4] << digit_arr[c & 15];
+	}
+	out << '"';
+	if (color.a != 255) {
+		out << ' ' << name << "-opacity=\"" << static_cast<float>(color.a) / 255.f << '"';
+	}
 }
 
-wykobi::rectangle<float> LineShape::getBoundingRectangle() {
-	return wykobi::make_rectangle(segment[0], segment[1]);
+void GeometryDisplay::writeSvgPolygon(std::ostream & out, const wykobi::polygon<float, 2> & poly, const DrawStyle & style, sf::Vector2f offset) {
+	if (poly.size() == 0 || (!style.inner_fill && !style.outer_line)) {
+		return;
+	}
+	out << "<path d=\"";
+	for (std::size_t i = 0; i < poly.size(); ++i) {
+		out << ((i == 0) ? 'M' : 'L') << poly[i].x + offset.x << ' ' << poly[i].y + offset.y;
+	}
+	out << "Z\"";
+	if (style.inner_fill) {
+		writeSvgPaint(out, "fill", style.fill_color);
+	}
+	else {
+		out << " fill=\"none\"";
+	}
+	if (style.outer_line) {
+		writeSvgPaint(out, "stroke", style.line_color);
+		out << " stroke-width=\"" << style.outer_line_thickness << '"';
+	}
+	out << "/>\n";
 }
 
 std::vector<wykobi::triangle<float, 2>> GeometryDisplay::makeTriangleLine(float x0, float y0, float x1, float y1, float thickness) {
@@ -1205,10 +3033,68 @@ std::vector<wykobi::triangle<float, 2>> GeometryDisplay::makeTriangleLine(float
 	return triangle_vec;
 }
 
-std::vector<wykobi::triangle<float, 2>>GeometryDisplay::makeTriangleLine(wykobi::segment<float, 2> & seg, float thickness) {
+std::vector<wykobi::triangle<float, 2>>GeometryDisplay::makeTriangleLine(const wykobi::segment<float, 2> & seg, float thickness) {
 	return makeTriangleLine(seg[0].x, seg[0].y, seg[1].x, seg[1].y, thickness);
 }
 
+bool GeometryDisplay::pointInsidePolygon(sf::Vector2f point, const wykobi::polygon<float, 2> & poly) {
+	bool inside = false;
+	for (std::size_t i = 0, j = poly.size() - 1; i < poly.size(); j = i++) {
+		const wykobi::point2d<float> & a = poly[i];
+		const wykobi::point2d<float> & b = poly[j];
+		if ((a.y > point.y) != (b.y > point.y) &&
+			point.x < (b.x - a.x) * (point.y - a.y) / (b.y - a.y) + a.x) {
+			inside = !inside;
+		}
+	}
+	return inside;
+}
+
+float GeometryDisplay::pointSegmentDistance(sf::Vector2f point, const wykobi::segment<float, 2> & seg) {
+	sf::Vector2f e = closestSegmentPoint(point, seg) - point;
+	return std::sqrt(e.x * e.x + e.y * e.y);
+}
+
+sf::Vector2f GeometryDisplay::closestSegmentPoint(sf::Vector2f point, const wykobi::segment<float, 2> & seg) {
+	float dx = seg[1].x - seg[0].x;
+	float dy = seg[1].y - seg[0].y;
+	float length_sq = dx * dx + dy * dy;
+	float t = 0.f;
+	if (length_sq > 0.f) {
+		t = ((point.x - seg[0].x) * dx + (point.y - seg[0].y) * dy) / length_sq;
+		t = std::max(0.f, std::min(1.f, t));
+	}
+	return { seg[0].x + t * dx, seg[0].y + t * dy };
+}
+
+wykobi::polygon<float, 2> GeometryDisplay::makeRectanglePolygon(const wykobi::rectangle<float> & rect) {
+	return wykobi::make_polygon(std::vector<wykobi::point2d<float>>{
+		wykobi::make_point(rect[0].x, rect[0].y),
+		wykobi::make_point(rect[1].x, rect[0].y),
+		wykobi::make_point(rect[1].x, rect[1].y),
+		wykobi::make_point(rect[0].x, rect[1].y)
+	});
+}
+
+bool GeometryDisplay::polygonIntersectPolygon(const wykobi::polygon<float, 2> & a, const wykobi::polygon<float, 2> & b) {
+	if (a.size() == 0 || b.size() == 0) {
+		return false;
+	}
+	//one inside the other, or edges cross
+	if (pointInsidePolygon({ a[0].x, a[0].y }, b) || pointInsidePolygon({ b[0].x, b[0].y }, a)) {
+		return true;
+	}
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		wykobi::segment<float, 2> seg = wykobi::edge(a, i);
+		for (std::size_t j = 0; j < b.size(); ++j) {
+			if (wykobi::intersect(seg, wykobi::edge(b, j))) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 bool GeometryDisplay::segmentIntersectPolygon(wykobi::segment<float, 2> & seg, wykobi::polygon<float, 2> & poly) {
 	for (std::size_t i = 0; i < poly.size(); ++i) {
 		if (wykobi::intersect(wykobi::edge(poly, i), seg)) {
@@ -1342,4 +3228,464 @@ std::vector<wykobi::point2d<float>> GeometryDisplay::parsePoints(std::string & s
 	return out_vec;
 }
 
+bool GeometryDisplay::parseShapeFile(std::string path, bool detect_instances, std::vector<std::shared_ptr<const DrawObject>> & out_vec) {
+	out_vec.clear();
+	std::unordered_map<std::string, std::shared_ptr<const ShapePrototype>> prototype_map;
+	//polygons moved to origin with vertices in steps of instance_step, first entry is the style
+	//float subtraction is not exact, so copies at different offsets only match after rounding
+	const double instance_step = 1.0 / 1024.0;
+	typedef std::vector<std::int64_t> InstanceKey;
+	std::map<InstanceKey, std::size_t> instance_count_map;
+	struct InstanceCandidate {
+		std::size_t index;			//in out_vec
+		std::map<InstanceKey, std::size_t>::iterator count_it;
+	};
+	std::vector<InstanceCandidate> instance_candidate_vec;
+	std::fstream file;
+	std::string line;
+	file.open(path, std::ios::in);
+	if (!file.is_open()) {
+		std::cout << "File open failed: " << path << "\n";
+		return false;
+	}
+	while (std::getline(file, line)) {
+		std::unordered_map<std::string, std::string> settings_map;
+		auto vec_1 = splitString(line, ' ');
+		for (std::string & str : vec_1) {
+			auto vec_2 = splitString(str, '=');
+			if (vec_2.size() == 2) {
+				settings_map.emplace(vec_2[0], vec_2[1]);
+			}
+		}
+		//check type
+		std::unordered_map<std::string, std::string>::iterator it;
+		it = settings_map.find("type");
+		if (it == settings_map.end()) {
+			continue;
+		}
+		std::shared_ptr<const DrawObject> shape;
+		if (it->second == "polygon") {
+			std::shared_ptr<const PolygonShape> polygon_shape = std::make_shared<const PolygonShape>(settings_map);
+			shape = polygon_shape;
+			if (detect_instances && polygon_shape->polygon.size() > 0 && settings_map.find("define_prototype") == settings_map.end()) {
+				//counted here, polygons are only turned into instances after the whole file is read
+				const wykobi::polygon<float, 2> & poly = polygon_shape->polygon;
+				InstanceKey key;
+				key.reserve(poly.size() * 2 + 1);
+				key.push_back(polygon_shape->style_id);
+				for (std::size_t i = 0; i < poly.size(); ++i) {
+					key.push_back(std::llround((static_cast<double>(poly[i].x) - poly[0].x) / instance_step));
+					key.push_back(std::llround((static_cast<double>(poly[i].y) - poly[0].y) / instance_step));
+				}
+				auto count_it = instance_count_map.emplace(std::move(key), 0).first;
+				++count_it->second;
+				instance_candidate_vec.push_back({ out_vec.size(), count_it });
+			}
+		}
+		else if (it->second == "line") {
+			shape = std::make_shared<const LineShape>(settings_map);
+		}
+		else if (it->second == "instance") {
+			it = settings_map.find("prototype");
+			if (it != settings_map.end()) {
+				auto prototype_it = prototype_map.find(it->second);
+				if (prototype_it != prototype_map.end()) {
+					shape = std::make_shared<const InstanceShape>(settings_map, prototype_it->second);
+				}
+				else {
+					std::cout << "Error: unknown prototype " << it->second << "\n";
+				}
+			}
+		}
+		if (!shape) {
+			continue;
+		}
+		it = settings_map.find("define_prototype");
+		if (it != settings_map.end()) {
+			prototype_map[it->second] = std::make_shared<const ShapePrototype>(shape);
+		}
+		else {
+			out_vec.push_back(shape);
+		}
+	}
+	file.close();
+
+	//only geometry that occurs more than once gets a prototype
+	std::map<const InstanceKey*, std::shared_ptr<const ShapePrototype>> detect_map;
+	for (const InstanceCandidate & candidate : instance_candidate_vec) {
+		if (candidate.count_it->second < 2) {
+			continue;
+		}
+		const PolygonShape & polygon_shape = static_cast<const PolygonShape &>(*out_vec[candidate.index]);
+		wykobi::point2d<float> origin = polygon_shape.polygon[0];
+		auto detect_it = detect_map.find(&candidate.count_it->first);
+		if (detect_it == detect_map.end()) {
+			//first copy in the file is the prototype geometry
+			std::shared_ptr<PolygonShape> local_shape = std::make_shared<PolygonShape>(polygon_shape);
+			local_shape->name_id = 0;
+			for (std::size_t i = 0; i < local_shape->polygon.size(); ++i) {
+				local_shape->polygon[i].x -= origin.x;
+				local_shape->polygon[i].y -= origin.y;
+			}
+			detect_it = detect_map.emplace(&candidate.count_it->first, std::make_shared<const ShapePrototype>(local_shape)).first;
+		}
+		std::shared_ptr<InstanceShape> instance = std::make_shared<InstanceShape>(detect_it->second, sf::Vector2f(origin.x, origin.y));
+		instance->name_id = polygon_shape.name_id;
+		out_vec[candidate.index] = instance;
+	}
+	return true;
+}
+
+wykobi::rectangle<float> GeometryDisplay::fitWorldRectangle(const std::vector<std::shared_ptr<const DrawObject>> & shape_vec, sf::Vector2u size) {
+	wykobi::rectangle<float> rect = wykobi::make_rectangle(0.f, 0.f, 0.f, 0.f);
+	for (std::size_t i = 0; i < shape_vec.size(); ++i) {
+		wykobi::rectangle<float> shape_rect = SpatialIndex::normalizeRectangle(shape_vec[i]->getBoundingRectangle());
+		if (i == 0) {
+			rect = shape_rect;
+		}
+		else {
+			rect[0].x = std::min(rect[0].x, shape_rect[0].x);
+			rect[0].y = std::min(rect[0].y, shape_rect[0].y);
+			rect[1].x = std::max(rect[1].x, shape_rect[1].x);
+			rect[1].y = std::max(rect[1].y, shape_rect[1].y);
+		}
+	}
+	//widen the short side around the centre so pixels stay square
+	float width = std::max(rect[1].x - rect[0].x, 1.f);
+	float height = std::max(rect[1].y - rect[0].y, 1.f);
+	float image_ratio = static_cast<float>(std::max(size.x, 1u)) / static_cast<float>(std::max(size.y, 1u));
+	if (width / height < image_ratio) {
+		width = height * image_ratio;
+	}
+	else {
+		height = width / image_ratio;
+	}
+	float centre_x = (rect[0].x + rect[1].x) / 2.f;
+	float centre_y = (rect[0].y + rect[1].y) / 2.f;
+	return wykobi::make_rectangle(centre_x - width / 2.f, centre_y - height / 2.f, centre_x + width / 2.f, centre_y + height / 2.f);
+}
+
+void GeometryDisplay::renderShapesToImage(const std::vector<std::shared_ptr<const DrawObject>> & shape_vec, const wykobi::rectangle<float> & world_rect, sf::Vector2u size, sf::Color background_color, sf::Image & out_image) {
+	SoftwareRasterizer rasterizer(size, world_rect);
+	rasterizer.clear(background_color);
+	//each thread tessellates a contiguous range, so draw order is kept when the arrays are queued in order
+	wykobi::rectangle<float> cull_rect = SpatialIndex::normalizeRectangle(world_rect);
+	unsigned int thread_count = std::max(1u, std::thread::hardware_concurrency());
+	std::size_t batch_size = (shape_vec.size() + thread_count - 1) / thread_count;
+	std::vector<sf::VertexArray> vertex_arr_vec(thread_count, sf::VertexArray(sf::Triangles));
+	std::vector<std::vector<std::size_t>> shape_end_vec_vec(thread_count);		//vertex count after each shape
+	std::vector<std::thread> thread_vec;
+	for (unsigned int t = 0; t < thread_count; ++t) {
+		thread_vec.emplace_back([&, t]() {
+			std::size_t begin = std::min(shape_vec.size(), t * batch_size);
+			std::size_t end = std::min(shape_vec.size(), begin + batch_size);
+			for (std::size_t i = begin; i < end; ++i) {
+				if (SpatialIndex::rectangleIntersect(SpatialIndex::normalizeRectangle(shape_vec[i]->getBoundingRectangle()), cull_rect)) {
+					shape_vec[i]->appendVertex(vertex_arr_vec[t]);
+					shape_end_vec_vec[t].push_back(vertex_arr_vec[t].getVertexCount());
+				}
+			}
+		});
+	}
+	for (std::thread & t : thread_vec) {
+		t.join();
+	}
+	for (unsigned int t = 0; t < thread_count; ++t) {
+		std::size_t shape_begin = 0;
+		for (std::size_t shape_end : shape_end_vec_vec[t]) {
+			rasterizer.draw(vertex_arr_vec[t], shape_begin, shape_end);
+			shape_begin = shape_end;
+		}
+	}
+	rasterizer.render();
+	rasterizer.copyToImage(out_image);
+}
+
+bool GeometryDisplay::renderShapeFileToImage(std::string path, std::string image_path, sf::Vector2u size, wykobi::rectangle<float> world_rect) {
+	std::vector<std::shared_ptr<const DrawObject>> shape_vec;
+	if (!parseShapeFile(path, false, shape_vec)) {
+		return false;
+	}
+	if (world_rect[1].x == world_rect[0].x || world_rect[1].y == world_rect[0].y) {
+		world_rect = fitWorldRectangle(shape_vec, size);
+	}
+	sf::Image image;
+	renderShapesToImage(shape_vec, world_rect, size, sf::Color::White, image);
+	if (!image.saveToFile(image_path)) {
+		std::cout << "Image save failed: " << image_path << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool GeometryDisplay::writeSvgFile(std::string path, const std::vector<std::shared_ptr<const DrawObject>> & shape_vec, const wykobi::rectangle<float> & world_rect, sf::Vector2u size, bool cull, float min_pixel_size) {
+	//buffer has to be set before open and outlive the stream
+	std::vector<char> buffer(1 << 20);
+	std::ofstream file;
+	file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	file.open(path);
+	if (!file) {
+		std::cout << "Svg save failed: " << path << "\n";
+		return false;
+	}
+	wykobi::rectangle<float> view_rect = SpatialIndex::normalizeRectangle(world_rect);
+	float width = view_rect[1].x - view_rect[0].x;
+	float height = view_rect[1].y - view_rect[0].y;
+	//svg pixels are square when size has the aspect ratio of world_rect
+	float unit_per_pixel = (size.x > 0) ? width / static_cast<float>(size.x) : 0.f;
+	float min_size = min_pixel_size * unit_per_pixel;
+	file << std::setprecision(std::numeric_limits<float>::max_digits10);
+	file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+	file << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << size.x << "\" height=\"" << size.y << '"';
+	file << " viewBox=\"" << view_rect[0].x << ' ' << view_rect[0].y << ' ' << width << ' ' << height << "\">\n";
+	for (const std::shared_ptr<const DrawObject> & shape : shape_vec) {
+		wykobi::rectangle<float> shape_rect = SpatialIndex::normalizeRectangle(shape->getBoundingRectangle());
+		if (cull && !SpatialIndex::rectangleIntersect(shape_rect, view_rect)) {
+			continue;
+		}
+		if (shape_rect[1].x - shape_rect[0].x < min_size && shape_rect[1].y - shape_rect[0].y < min_size) {
+			continue;
+		}
+		shape->writeStyledSvg(file, shape->getStyle(), sf::Vector2f(0.f, 0.f));
+	}
+	file << "</svg>\n";
+	file.flush();
+	if (!file) {
+		std::cout << "Svg save failed: " << path << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool GeometryDisplay::renderShapeFileToSvg(std::string path, std::string svg_path, sf::Vector2u size, wykobi::rectangle<float> world_rect) {
+	std::vector<std::shared_ptr<const DrawObject>> shape_vec;
+	if (!parseShapeFile(path, false, shape_vec)) {
+		return false;
+	}
+	if (world_rect[1].x == world_rect[0].x || world_rect[1].y == world_rect[0].y) {
+		world_rect = fitWorldRectangle(shape_vec, size);
+	}
+	return writeSvgFile(svg_path, shape_vec, world_rect, size, false, 0.f);
+}
+
+bool GeometryDisplay::makeDirectory(std::string path) {
+#ifdef _WIN32
+	int result = _mkdir(path.c_str());
+#else
+	int result = mkdir(path.c_str(), 0755);
+#endif
+	return result == 0 || errno == EEXIST;
+}
+
+bool GeometryDisplay::exportTilePyramid(std::string out_dir, const std::vector<std::shared_ptr<const DrawObject>> & shape_vec, const wykobi::rectangle<float> & world_rect, unsigned int tile_size, unsigned int max_level, sf::Color background_color) {
+	tile_size = std::max(1u, tile_size);
+	if (max_level > max_tile_pyramid_level) {
+		std::cout << "Tile level too large: " << max_level << ", at most " << max_tile_pyramid_level << "\n";
+		return false;
+	}
+	if (!makeDirectory(out_dir)) {
+		std::cout << "Directory create failed: " << out_dir << "\n";
+		return false;
+	}
+	for (unsigned int z = 0; z <= max_level; ++z) {
+		makeDirectory(out_dir + "/" + std::to_string(z));
+	}
+	wykobi::rectangle<float> rect = SpatialIndex::normalizeRectangle(world_rect);
+	float side = std::max(std::max(rect[1].x - rect[0].x, rect[1].y - rect[0].y), 1.f);
+	sf::Vector2f origin((rect[0].x + rect[1].x - side) / 2.f, (rect[0].y + rect[1].y - side) / 2.f);
+
+	unsigned int thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	//bounds are computed once in parallel, compact shapes decode their vertices to get them
+	std::vector<wykobi::rectangle<float>> bounding_rectangle_vec(shape_vec.size());
+	{
+		std::size_t batch_size = (shape_vec.size() + thread_count - 1) / thread_count;
+		std::vector<std::thread> thread_vec;
+		for (unsigned int t = 0; t < thread_count; ++t) {
+			thread_vec.emplace_back([&, t]() {
+				std::size_t begin = std::min(shape_vec.size(), t * batch_size);
+				std::size_t end = std::min(shape_vec.size(), begin + batch_size);
+				for (std::size_t i = begin; i < end; ++i) {
+					bounding_rectangle_vec[i] = SpatialIndex::normalizeRectangle(shape_vec[i]->getBoundingRectangle());
+				}
+			});
+		}
+		for (std::thread & t : thread_vec) {
+			t.join();
+		}
+	}
+	SpatialIndex index;
+	for (std::size_t i = 0; i < shape_vec.size(); ++i) {
+		index.insert(i, bounding_rectangle_vec[i]);
+	}
+
+	//tiles are visited top down, children are only queued under tiles with shapes
+	//the queue is a stack, so it holds a few tiles per level instead of a whole level
+	struct TileTask {
+		unsigned int z;
+		std::uint32_t x;
+		std::uint32_t y;
+	};
+	std::vector<TileTask> tile_stack = { { 0, 0, 0 } };
+	std::size_t active_count = 0;		//tiles being rendered, they may still queue children
+	std::mutex tile_mutex;
+	std::condition_variable tile_condition;
+	std::atomic<bool> failed{ false };
+	auto work = [&]() {
+		std::size_t pixel_count = static_cast<std::size_t>(tile_size) * tile_size;
+		std::vector<std::size_t> id_vec;
+		std::vector<float> splat_vec(pixel_count * 4, 0.f);		//fill color times coverage, then coverage
+		std::vector<std::size_t> splat_pixel_vec;
+		sf::VertexArray vertex_arr(sf::Triangles);
+		std::vector<std::size_t> shape_end_vec;		//vertex count after each shape, splat quads count as one shape
+		sf::Image image;
+		float left = 0.f;
+		float top = 0.f;
+		float pixel = 1.f;
+		//append one quad per pixel holding summed small shapes
+		auto flushSplat = [&]() {
+			for (std::size_t pixel_index : splat_pixel_vec) {
+				float* splat = &splat_vec[pixel_index * 4];
+				sf::Color color(
+					static_cast<sf::Uint8>(std::min(255.f, splat[0] / splat[3])),
+					static_cast<sf::Uint8>(std::min(255.f, splat[1] / splat[3])),
+					static_cast<sf::Uint8>(std::min(255.f, splat[2] / splat[3])),
+					static_cast<sf::Uint8>(std::min(1.f, splat[3]) * 255.f + 0.5f)
+				);
+				float x0 = left + pixel * static_cast<float>(pixel_index % tile_size);
+				float y0 = top + pixel * static_cast<float>(pixel_index / tile_size);
+				float x1 = x0 + pixel;
+				float y1 = y0 + pixel;
+				vertex_arr.append(sf::Vertex(sf::Vector2f(x0, y0), color));
+				vertex_arr.append(sf::Vertex(sf::Vector2f(x1, y0), color));
+				vertex_arr.append(sf::Vertex(sf::Vector2f(x1, y1), color));
+				vertex_arr.append(sf::Vertex(sf::Vector2f(x0, y0), color));
+				vertex_arr.append(sf::Vertex(sf::Vector2f(x1, y1), color));
+				vertex_arr.append(sf::Vertex(sf::Vector2f(x0, y1), color));
+				splat[0] = splat[1] = splat[2] = splat[3] = 0.f;
+			}
+			if (!splat_pixel_vec.empty()) {
+				shape_end_vec.push_back(vertex_arr.getVertexCount());
+			}
+			splat_pixel_vec.clear();
+		};
+		while (true) {
+			TileTask task;
+			{
+				std::unique_lock<std::mutex> m_lock(tile_mutex);
+				tile_condition.wait(m_lock, [&]() { return !tile_stack.empty() || active_count == 0; });
+				if (tile_stack.empty()) {
+					return;
+				}
+				task = tile_stack.back();
+				tile_stack.pop_back();
+				++active_count;
+			}
+			unsigned int z = task.z;
+			std::uint32_t x = task.x;
+			std::uint32_t y = task.y;
+			std::uint32_t side_count = std::uint32_t(1) << z;
+			float tile_side = side / static_cast<float>(side_count);
+			pixel = tile_side / static_cast<float>(tile_size);
+			left = origin.x + tile_side * static_cast<float>(x);
+			top = origin.y + tile_side * static_cast<float>(y);
+			wykobi::rectangle<float> tile_rect = wykobi::make_rectangle(left, top, left + tile_side, top + tile_side);
+
+			id_vec.clear();
+			index.query(tile_rect, id_vec);
+			{
+				std::unique_lock<std::mutex> m_lock(tile_mutex);
+				if (!id_vec.empty() && z < max_level) {
+					for (std::uint32_t i = 0; i < 4; ++i) {
+						tile_stack.push_back({ z + 1, x * 2 + i % 2, y * 2 + i / 2 });
+					}
+				}
+				--active_count;
+			}
+			tile_condition.notify_all();
+			if (id_vec.empty()) {
+				continue;
+			}
+			//index returns tree order, draw order is shape order
+			std::sort(id_vec.begin(), id_vec.end());
+
+			vertex_arr.clear();
+			shape_end_vec.clear();
+			for (std::size_t id : id_vec) {
+				const wykobi::rectangle<float> & shape_rect = bounding_rectangle_vec[id];
+				float width = shape_rect[1].x - shape_rect[0].x;
+				float height = shape_rect[1].y - shape_rect[0].y;
+				if (width >= pixel || height >= pixel) {
+					//small shapes drawn before this one stay under it
+					flushSplat();
+					shape_vec[id]->appendVertex(vertex_arr);
+					shape_end_vec.push_back(vertex_arr.getVertexCount());
+					continue;
+				}
+				//shape is inside one pixel, only its color and area are kept
+				float centre_x = ((shape_rect[0].x + shape_rect[1].x) / 2.f - left) / pixel;
+				float centre_y = ((shape_rect[0].y + shape_rect[1].y) / 2.f - top) / pixel;
+				if (centre_x < 0.f || centre_y < 0.f || centre_x >= static_cast<float>(tile_size) || centre_y >= static_cast<float>(tile_size)) {
+					continue;
+				}
+				DrawStyle style = shape_vec[id]->getStyle();
+				sf::Color color;
+				if (style.inner_fill) {
+					color = style.fill_color;
+				}
+				else if (style.outer_line) {
+					color = style.line_color;
+				}
+				else {
+					continue;
+				}
+				float area = width * height;
+				const LineShape* line = dynamic_cast<const LineShape*>(shape_vec[id].get());
+				if (line != nullptr) {
+					area = std::hypot(width, height) * line->thickness;
+				}
+				float coverage = std::min(1.f, area / (pixel * pixel)) * static_cast<float>(color.a) / 255.f;
+				if (coverage <= 0.f) {
+					continue;
+				}
+				std::size_t pixel_index = static_cast<std::size_t>(centre_y) * tile_size + static_cast<std::size_t>(centre_x);
+				float* splat = &splat_vec[pixel_index * 4];
+				if (splat[3] == 0.f) {
+					splat_pixel_vec.push_back(pixel_index);
+				}
+				splat[0] += static_cast<float>(color.r) * coverage;
+				splat[1] += static_cast<float>(color.g) * coverage;
+				splat[2] += static_cast<float>(color.b) * coverage;
+				splat[3] += coverage;
+			}
+			flushSplat();
+
+			SoftwareRasterizer rasterizer(sf::Vector2u(tile_size, tile_size), tile_rect);
+			rasterizer.clear(background_color);
+			std::size_t shape_begin = 0;
+			for (std::size_t shape_end : shape_end_vec) {
+				rasterizer.draw(vertex_arr, shape_begin, shape_end);
+				shape_begin = shape_end;
+			}
+			rasterizer.render(1);
+			rasterizer.copyToImage(image);
+			std::string dir = out_dir + "/" + std::to_string(z) + "/" + std::to_string(x);
+			std::string image_path = dir + "/" + std::to_string(y) + ".png";
+			if (!makeDirectory(dir) || !image.saveToFile(image_path)) {
+				std::cout << "Image save failed: " << image_path << "\n";
+				failed = true;
+			}
+		}
+	};
+	std::vector<std::thread> thread_vec;
+	for (unsigned int i = 1; i < thread_count; ++i) {
+		thread_vec.emplace_back(work);
+	}
+	work();
+	for (std::thread & t : thread_vec) {
+		t.join();
+	}
+	return !failed;
+}
+
 //end
\ No newline at end of file
@@ -8,16 +8,24 @@
 #include <ostream>
 #include <sstream>
 #include <fstream>
+#include <iomanip>
 #include <string>
 #include <vector>
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <future>
 #include <functional>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 
 #include <cmath>
 
@@ -28,35 +36,232 @@
 
 #include "StandardCursor.hpp"
 #include "FileDialog.hpp"
+#include "MPSCQueue.hpp"
+#include "ChunkedVector.hpp"
+#include "StyleTable.hpp"
+#include "SpatialIndex.hpp"
+#include "LabelGrid.hpp"
+#include "PointKdTree.hpp"
+#include "FrameStats.hpp"
+#include "SoftwareRasterizer.hpp"
 
 namespace GeometryDisplay {
 	class DrawObject {
 	public:
-		std::string name;
-		bool inner_fill = true;
-		bool outer_line = false;
-		sf::Color fill_color;
-		sf::Color line_color;
-		float outer_line_thickness = 2.f;
+		//indices into NamePool and StyleTable
+		NameId name_id = 0;
+		StyleId style_id = 0;
 
 		DrawObject() = default;
 		DrawObject(std::unordered_map<std::string, std::string> & settings_map);
-		virtual sf::Vector2f getCentroid() = 0;
-		virtual wykobi::rectangle<float> getBoundingRectangle() = 0;
-		virtual DrawObject* clone() = 0;
-		virtual void appendVertex(sf::VertexArray & vertex_arr) = 0;
-		virtual std::string toString();
+		virtual ~DrawObject() = default;
+		virtual sf::Vector2f getCentroid() const = 0;
+		virtual wykobi::rectangle<float> getBoundingRectangle() const = 0;
+		virtual DrawObject* clone() const = 0;
+		virtual std::string toString() const;
+
+		/*
+		Append triangles using style
+		*/
+		virtual void appendStyledVertex(sf::VertexArray & vertex_arr, const DrawStyle & style) const = 0;
+
+		/*
+		Append triangles using current StyleTable entry
+		*/
+		void appendVertex(sf::VertexArray & vertex_arr) const;
+
+		/*
+		Write svg path elements using style
+		offset is added to every point
+		*/
+		virtual void writeStyledSvg(std::ostream & out, const DrawStyle & style, sf::Vector2f offset) const = 0;
+
+		/*
+		Check if point is on the parts drawn with style
+		tolerance is added to the half thickness of lines
+		*/
+		virtual bool containsStyledPoint(sf::Vector2f point, const DrawStyle & style, float tolerance) const = 0;
+
+		/*
+		Check if point is on shape using current StyleTable entry
+		*/
+		bool containsPoint(sf::Vector2f point, float tolerance) const;
+
+		/*
+		Check if geometry overlaps region, style and line thickness are ignored
+		*/
+		virtual bool intersectsPolygon(const wykobi::polygon<float, 2> & region) const = 0;
+
+		/*
+		Append corner points of geometry
+		*/
+		virtual void appendCornerPoints(std::vector<sf::Vector2f> & out_vec) const = 0;
+
+		/*
+		Get closest point on outline of geometry
+		return:
+			distance to out_point, infinity if shape has no outline
+		*/
+		virtual float closestOutlinePoint(sf::Vector2f point, sf::Vector2f & out_point) const = 0;
+
+		/*
+		Append edges of outline, the same edges closestOutlinePoint searches
+		*/
+		virtual void appendOutlineSegments(std::vector<wykobi::segment<float, 2>> & out_vec) const = 0;
+
+		/*
+		Get/set name
+		*/
+		const std::string & getName() const;
+		void setName(const std::string & name);
+
+		/*
+		Get/set style
+		Setters intern a new style for this shape only
+		*/
+		DrawStyle getStyle() const;
+		void setStyle(const DrawStyle & style);
+		void setInnerFill(bool v);
+		void setOuterLine(bool v);
+		void setFillColor(sf::Color color);
+		void setLineColor(sf::Color color);
+		void setOuterLineThickness(float thickness);
+
+	protected:
+		/*
+		Overwrite the attributes of style found in settings_map
+		*/
+		static DrawStyle parseStyle(std::unordered_map<std::string, std::string> & settings_map, DrawStyle style);
+	};
+
+	/*
+	Handle returned by Window::addShape
+	*/
+	typedef std::size_t ShapeId;
+
+	/*
+	ShapeId that never refers to a shape
+	*/
+	const ShapeId null_shape_id = static_cast<ShapeId>(-1);
+
+	/*
+	Immutable copy of the shapes in a Window
+	Published by window_thread, can be read from any thread without locking
+	Shares every chunk the window has not written since the last snapshot, so publishing is O(chunks changed)
+	*/
+	struct DrawObjectSnapshot {
+		ChunkedVector<std::shared_ptr<const DrawObject>> draw_object_vec;
+		ChunkedVector<ShapeId> id_vec;
+		std::shared_ptr<const StyleClassMap> style_class_map = std::make_shared<const StyleClassMap>();
+		std::uint64_t rebuild_version = 0;		//changes when shapes are updated or removed, adding shapes or restyling keeps it
+	};
+
+	/*
+	Get shape drawn with the style of its class in style_class_map
+	return:
+		shape itself if its class is not restyled, else a copy with the StyleTable id of the class
+	*/
+	std::shared_ptr<const DrawObject> resolveStyleClass(const std::shared_ptr<const DrawObject> & shape, const StyleClassMap & style_class_map);
+
+	/*
+	World space geometry of a snapshot, built by prep_thread and drawn by window_thread
+	Vertices and per shape arrays are split into chunks, so a frame can share the chunks of the previous one when shapes were only added
+	*/
+	struct PreparedFrame {
+		struct VertexRange {
+			std::size_t chunk = 0;
+			std::size_t begin = 0;
+			std::size_t end = 0;
+		};
+
+		/*
+		Bounding rectangles of shapes begin to end, id is shape index
+		*/
+		struct ShapeIndexRun {
+			std::shared_ptr<const SpatialIndex> index;
+			std::size_t begin = 0;
+			std::size_t end = 0;
+		};
+
+		static const std::size_t chunk_vertex_count = 65536;
+
+		std::shared_ptr<const DrawObjectSnapshot> snapshot;
+		std::vector<std::shared_ptr<const sf::VertexArray>> chunk_vec;
+		ChunkedVector<VertexRange> range_vec;								//vertices of each shape
+		ChunkedVector<sf::Vector2f> centroid_vec;							//label position of each shape
+		ChunkedVector<wykobi::rectangle<float>> bounding_rectangle_vec;	//normalized
+		std::vector<std::shared_ptr<const std::vector<std::size_t>>> label_run_vec;	//named shapes, each run in label order and less than half the size of the one before
+		std::vector<std::size_t> chunk_begin_vec;						//first shape of each chunk
+		std::vector<std::shared_ptr<const std::vector<StyleId>>> chunk_class_vec;	//sorted style classes of the shapes in each chunk
+		std::vector<ShapeIndexRun> index_run_vec;						//every shape, each run less than half the size of the one before
+		wykobi::rectangle<float> bounding_rectangle;					//of every shape, only valid if range_vec is not empty
+		std::size_t vertex_count = 0;
+		float prepare_ms = 0.f;
+
+		/*
+		Tessellate snapshot
+		previous:
+			frame prepared from an earlier snapshot, reused if shapes were only added or restyled since then
+			only chunks with a restyled class are tessellated again
+		*/
+		static std::shared_ptr<const PreparedFrame> prepare(std::shared_ptr<const DrawObjectSnapshot> snapshot, std::shared_ptr<const PreparedFrame> previous);
+
+		/*
+		Check if label of shape a is placed before label of shape b
+		Largest bounding rectangle first, draw order breaks ties so labels are stable between frames
+		*/
+		bool labelBefore(std::size_t a, std::size_t b) const;
+
+		/*
+		Append named shapes to out_vec in label order
+		view_rect:
+			only shapes overlapping it are appended, nullptr appends every named shape
+		*/
+		void appendLabels(const wykobi::rectangle<float>* view_rect, std::vector<std::size_t> & out_vec) const;
+
+		/*
+		Append shapes whose bounding rectangle overlaps rect to out_vec, unordered
+		begin:
+			only shapes from this index and onwards are appended
+		*/
+		void queryShapes(const wykobi::rectangle<float> & rect, std::size_t begin, std::vector<std::size_t> & out_vec) const;
+	};
+
+	/*
+	Scene mutation queued by producer threads
+	Applied by window_thread once per frame
+	*/
+	struct SceneCommand {
+		enum Type {
+			Add,
+			Update,
+			Remove,
+			Clear,
+			Restyle
+		};
+		Type type;
+		ShapeId id;
+		std::shared_ptr<const DrawObject> shape;
+		StyleId restyle_from = 0;		//Restyle draws style class restyle_from with StyleTable entry restyle_to
+		StyleId restyle_to = 0;
 	};
+
 	class PolygonShape : public DrawObject {
 	public:
 		wykobi::polygon<float, 2> polygon;
 		PolygonShape(wykobi::polygon<float, 2> poly);
 		PolygonShape(std::unordered_map<std::string, std::string> & settings_map);
-		PolygonShape* clone() override;
-		sf::Vector2f getCentroid() override;
-		wykobi::rectangle<float> getBoundingRectangle() override;
-		void appendVertex(sf::VertexArray & vertex_arr) override;
-		std::string toString() override;
+		PolygonShape* clone() const override;
+		sf::Vector2f getCentroid() const override;
+		wykobi::rectangle<float> getBoundingRectangle() const override;
+		void appendStyledVertex(sf::VertexArray & vertex_arr, const DrawStyle & style) const override;
+		void writeStyledSvg(std::ostream & out, const DrawStyle & style, sf::Vector2f offset) const override;
+		bool containsStyledPoint(sf::Vector2f point, const DrawStyle & style, float tolerance) const override;
+		bool intersectsPolygon(const wykobi::polygon<float, 2> & region) const override;
+		void appendCornerPoints(std::vector<sf::Vector2f> & out_vec) const override;
+		float closestOutlinePoint(sf::Vector2f point, sf::Vector2f & out_point) const override;
+		void appendOutlineSegments(std::vector<wykobi::segment<float, 2>> & out_vec) const override;
+		std::string toString() const override;
 	};
 	class LineShape : public DrawObject {
 	public:
@@ -64,11 +269,152 @@ namespace GeometryDisplay {
 		float thickness = 1.f;
 		LineShape(wykobi::segment<float, 2> seg);
 		LineShape(std::unordered_map<std::string, std::string> & settings_map);
-		LineShape* clone() override;
-		sf::Vector2f getCentroid() override;
-		wykobi::rectangle<float> getBoundingRectangle() override;
-		void appendVertex(sf::VertexArray & vertex_arr) override;
-		std::string toString() override;
+		LineShape* clone() const override;
+		sf::Vector2f getCentroid() const override;
+		wykobi::rectangle<float> getBoundingRectangle() const override;
+		void appendStyledVertex(sf::VertexArray & vertex_arr, const DrawStyle & style) const override;
+		void writeStyledSvg(std::ostream & out, const DrawStyle & style, sf::Vector2f offset) const override;
+		bool containsStyledPoint(sf::Vector2f point, const DrawStyle & style, float tolerance) const override;
+		bool intersectsPolygon(const wykobi::polygon<float, 2> & region) const override;
+		void appendCornerPoints(std::vector<sf::Vector2f> & out_vec) const override;
+		float closestOutlinePoint(sf::Vector2f point, sf::Vector2f & out_point) const override;
+		void appendOutlineSegments(std::vector<wykobi::segment<float, 2>> & out_vec) const override;
+		std::string toString() const override;
+	};
+
+	/*
+	Split of the world into square tiles used by CompactPolygonShape
+	Vertices are stored as 16 bit steps from the origin of their tile
+	*/
+	struct QuantizedTiling {
+		double step = 1.0 / 64.0;		//rounding moves a vertex at most step / 2 on each axis, step / sqrt(2) in distance
+
+		/*
+		Make tiling whose rounding moves a vertex at most error_bound in distance
+		*/
+		static QuantizedTiling fromErrorBound(double error_bound);
+
+		/*
+		World size of tile
+		Half of the 16 bit range, so shapes starting anywhere in a tile may extend one tile further
+		*/
+		double tileSize() const;
+
+		/*
+		Get tile index containing v
+		*/
+		std::int32_t tileIndex(double v) const;
+
+		/*
+		Get world position of tile edge
+		*/
+		double tileOrigin(std::int32_t index) const;
+	};
+
+	class CompactPolygonShape : public DrawObject {
+	public:
+		QuantizedTiling tiling;
+		std::int32_t tile_x = 0;
+		std::int32_t tile_y = 0;
+		std::vector<std::array<std::uint16_t, 2>> vertex_vec;
+
+		/*
+		Make compact copy of shape
+		Every vertex is checked after decoding to float, so the error bound holds for what is drawn
+		return:
+			nullptr if shape does not fit in the 16 bit range of its tile, or a decoded vertex is further than the error bound of tiling
+		*/
+		static std::shared_ptr<CompactPolygonShape> fromPolygonShape(const PolygonShape & shape, QuantizedTiling tiling);
+
+		/*
+		Decode vertices to world coordinates
+		*/
+		wykobi::polygon<float, 2> decodePolygon() const;
+
+		/*
+		Decode vertices to world coordinates into out_poly
+		Reuses the capacity of out_poly
+		*/
+		void decodePolygon(wykobi::polygon<float, 2> & out_poly) const;
+
+		CompactPolygonShape* clone() const override;
+		sf::Vector2f getCentroid() const override;
+		wykobi::rectangle<float> getBoundingRectangle() const override;
+		void appendStyledVertex(sf::VertexArray & vertex_arr, const DrawStyle & style) const override;
+		void writeStyledSvg(std::ostream & out, const DrawStyle & style, sf::Vector2f offset) const override;
+		bool containsStyledPoint(sf::Vector2f point, const DrawStyle & style, float tolerance) const override;
+		bool intersectsPolygon(const wykobi::polygon<float, 2> & region) const override;
+		void appendCornerPoints(std::vector<sf::Vector2f> & out_vec) const override;
+		float closestOutlinePoint(sf::Vector2f point, sf::Vector2f & out_point) const override;
+		void appendOutlineSegments(std::vector<wykobi::segment<float, 2>> & out_vec) const override;
+		std::string toString() const override;
+
+	private:
+		/*
+		Decode into a PolygonShape owned by the calling thread, so queries do not allocate
+		Valid until the next call on the same thread
+		*/
+		const PolygonShape & decodeShape() const;
+	};
+
+	/*
+	Geometry shared by InstanceShape
+	Tessellated once when constructed, fill and outline are kept apart so instances can be restyled
+	Outlines of other thicknesses than the prototype style are tessellated once per thickness when first used
+	*/
+	class ShapePrototype {
+	public:
+		std::size_t id;
+		std::shared_ptr<const DrawObject> shape;
+		std::vector<sf::Vertex> fill_vertex_vec;
+		std::vector<sf::Vertex> line_vertex_vec;		//outline of line_thickness
+		float line_thickness;
+		wykobi::rectangle<float> bounding_rectangle;
+		sf::Vector2f centroid;
+		ShapePrototype(std::shared_ptr<const DrawObject> prototype_shape);
+
+		/*
+		Get outline triangles of thickness
+		Safe to call from any thread, reference stays valid for the lifetime of the prototype
+		*/
+		const std::vector<sf::Vertex> & getLineVertex(float thickness) const;
+
+		/*
+		Name used in files
+		*/
+		std::string getName() const;
+
+		/*
+		Line declaring prototype in file
+		*/
+		std::string toString() const;
+
+	private:
+		mutable std::mutex line_mutex;
+		mutable std::unordered_map<float, std::vector<sf::Vertex>> line_vertex_map;		//other thicknesses, guarded by line_mutex
+
+		/*
+		Tessellate outline of thickness into out_vec
+		*/
+		void tessellateLine(float thickness, std::vector<sf::Vertex> & out_vec) const;
+	};
+	class InstanceShape : public DrawObject {
+	public:
+		std::shared_ptr<const ShapePrototype> prototype;
+		sf::Vector2f offset;
+		InstanceShape(std::shared_ptr<const ShapePrototype> proto, sf::Vector2f instance_offset);
+		InstanceShape(std::unordered_map<std::string, std::string> & settings_map, std::shared_ptr<const ShapePrototype> proto);
+		InstanceShape* clone() const override;
+		sf::Vector2f getCentroid() const override;
+		wykobi::rectangle<float> getBoundingRectangle() const override;
+		void appendStyledVertex(sf::VertexArray & vertex_arr, const DrawStyle & style) const override;
+		void writeStyledSvg(std::ostream & out, const DrawStyle & style, sf::Vector2f offset) const override;
+		bool containsStyledPoint(sf::Vector2f point, const DrawStyle & style, float tolerance) const override;
+		bool intersectsPolygon(const wykobi::polygon<float, 2> & region) const override;
+		void appendCornerPoints(std::vector<sf::Vector2f> & out_vec) const override;
+		float closestOutlinePoint(sf::Vector2f point, sf::Vector2f & out_point) const override;
+		void appendOutlineSegments(std::vector<wykobi::segment<float, 2>> & out_vec) const override;
+		std::string toString() const override;
 	};
 
 	class UIPosition {
@@ -219,34 +565,181 @@ namespace GeometryDisplay {
 
 	};
 
+	/*
+	Square world tile of size 2^level at x, y in tiles
+	Caches the vertices of every shape of a prepared frame overlapping it, in draw order
+	*/
+	struct DrawObjectTile {
+		int level = 0;
+		std::int32_t x = 0;
+		std::int32_t y = 0;
+		std::vector<std::size_t> index_vec;		//in draw order
+		sf::VertexArray vertex_array = sf::VertexArray(sf::Triangles);
+		std::size_t shape_end = 0;				//shapes from here are not checked yet
+		bool vertex_dirty = false;				//vertex_array is built again from index_vec, set when the frame is restyled
+		bool overflow = false;					//too many vertices to cache, drawn from the chunks of the frame instead
+		std::uint64_t last_used = 0;			//frame the tile was last drawn
+	};
+
+	/*
+	Edges of one shape indexed for outline snapping
+	*/
+	struct OutlineSegmentIndex {
+		std::vector<wykobi::segment<float, 2>> segment_vec;
+		SpatialIndex index;		//bounding rectangles of segment_vec, id is position in segment_vec
+	};
+
+	/*
+	Kd-tree over corners snap_pending_vec[begin, end) of a Window, by sequence number
+	*/
+	struct SnapBlock {
+		std::shared_ptr<const PointKdTree> tree;
+		std::size_t begin = 0;
+		std::size_t end = 0;
+	};
+
 	class Window {
 	private:
+		/*
+		What changed since the last frame, decides which cached buffers are rebuilt
+		*/
+		enum Invalidation : unsigned int {
+			InvalidateView = 1,			//world_view or window size, rebuilds diagram lines and labels
+			InvalidateScene = 2,		//shapes or how they are drawn, rebuilds labels
+			InvalidateUI = 4,			//buttons, hover, selection and overlays, only redraws
+			InvalidateOverlay = 8		//tooltip position only, draws it over overlay_base_texture
+		};
+
 		sf::RenderWindow window;
 
 		std::string window_title = "Geometry Display";
 
 		std::shared_ptr<sf::Font> text_font;
 
-		int update_interval = 16;				//in ms
+		int update_interval = 16;				//shortest time between frames, in ms
+		int input_poll_interval = 10;			//in ms
+		int idle_poll_interval = 16;			//input poll interval after idle_after ms without input, at most update_interval
+		int idle_after = 1000;					//in ms
 		sf::Vector2u window_size = { 500, 500 };
-		bool update_frame = false;
-		bool running = true;
+		std::atomic<unsigned int> invalidation{ 0 };		//Invalidation flags of the next frame
+		std::atomic<bool> detect_instances{ false };
+		std::atomic<bool> compact_storage{ false };
+		std::atomic<double> compact_storage_error_bound{ 1.0 / 128.0 };
+		std::atomic<bool> running{ true };
 
 		std::mutex window_mutex;
 		std::thread window_thread;
 
+		//window_thread sleeps on wake_condition between frames
+		std::mutex wake_mutex;
+		std::condition_variable wake_condition;
+		std::atomic<bool> wake_pending{ false };
+
 		sf::Color window_background_color = sf::Color::White;
 
-		std::mutex draw_object_vec_mutex;
-		std::vector<std::unique_ptr<DrawObject>> draw_object_vec;
-		sf::VertexArray draw_object_vertex_array = sf::VertexArray(sf::Triangles);
+		//producers push here, window_thread drains once per frame
+		MPSCQueue<SceneCommand> scene_command_queue;
+		std::vector<SceneCommand> scene_command_vec;
+		std::atomic<ShapeId> next_shape_id{ 0 };
+
+		//only touched by window_thread
+		ChunkedVector<std::shared_ptr<const DrawObject>> draw_object_vec;
+		ChunkedVector<ShapeId> draw_object_id_vec;
+		std::unordered_map<ShapeId, std::size_t> draw_object_index_map;
+		std::shared_ptr<const StyleClassMap> style_class_map = std::make_shared<const StyleClassMap>();
+
+		//published copy, swapped with std::atomic_store and read with std::atomic_load
+		std::shared_ptr<const DrawObjectSnapshot> draw_object_snapshot = std::make_shared<const DrawObjectSnapshot>();
+
+		std::uint64_t draw_object_rebuild_version = 0;
+
+		//prep_thread tessellates each new snapshot while window_thread draws the previous frame
+		std::thread prep_thread;
+		std::mutex prep_mutex;
+		std::condition_variable prep_condition;
+		bool prep_pending = true;									//guarded by prep_mutex
+		std::shared_ptr<const PreparedFrame> prepared_frame_next;	//latest from prep_thread, swapped with std::atomic_store and read with std::atomic_load
+		std::shared_ptr<const PreparedFrame> prepared_frame;		//frame being drawn, only touched by window_thread
+
+		//bounding rectangles of draw_object_vec keyed by ShapeId, used for picking and queries
+		SpatialIndex draw_object_spatial_index;
+
+		//when part of the scene is visible it is drawn as tiles of a power of two size, about draw_object_tile_axis_count across the view
+		//each tile keeps its own vertices and is drawn clipped to its pixels, so overlap is the same as when every chunk is drawn
+		//tiles are brought up to date when drawn, and evicted when far from the view or least recently drawn
+		std::unordered_map<std::uint64_t, DrawObjectTile> draw_object_tile_map;
+		float draw_object_tile_axis_count = 4.f;
+		float draw_object_tile_min_size = 0.f;
+		std::size_t draw_object_tile_scan_count = 4096;			//fewer new shapes than this are checked one by one instead of through the frame index
+		std::size_t draw_object_tile_max_vertex_count = 1 << 18;		//larger tiles are drawn from the chunks of prepared_frame
+		std::size_t draw_object_tile_max_cached_vertex_count = 1 << 22;	//tiles not drawn this frame are evicted above this
+		std::size_t draw_object_tile_cached_vertex_count = 0;
+		std::uint64_t draw_object_tile_frame = 0;				//counts frames drawn with tiles
+		static const std::int32_t draw_object_tile_max_coordinate = 1 << 26;	//views further out are culled through the frame index
+		std::vector<std::size_t> draw_object_cull_vec;
 		unsigned int draw_object_text_size = 20;
+
+		//name labels, placed in label order and skipped if they overlap a placed label
+		//placed labels are kept until the view or scene changes
+		LabelGrid draw_object_label_grid;
+		std::vector<std::size_t> draw_object_label_vec;
+		std::vector<sf::Text> draw_object_label_text_vec;
+
+		//shape under mouse, shown with a tooltip
+		ShapeId hover_shape_id = null_shape_id;
+		sf::Texture overlay_base_texture;		//last full frame without tooltip and stats, valid while hovering
+		bool overlay_base_valid = false;
+		float pick_tolerance = 3.f;				//in pixels
+		sf::Color hover_background_color = sf::Color(255, 255, 225, 230);
+		sf::Color hover_text_color = sf::Color::Black;
+		unsigned int hover_text_char_size = 12;
+
+		//select mode, left drag selects shapes overlapping a rectangle
+		bool select_mode = false;
+		bool select_drag = false;
+		sf::Vector2f select_start_pos;
+		sf::Vector2f select_current_pos;
+		std::vector<ShapeId> selected_id_vec;
+		sf::VertexArray selection_vertex_array = sf::VertexArray(sf::Lines);
+		sf::Color selection_color = sf::Color(255, 140, 0);
+		std::size_t query_thread_batch_size = 4096;		//candidates per refinement thread
+
+		//snapping for m_polygon_shape_maker, corners are kept in a kd-tree built on a background thread
+		std::shared_ptr<const PointKdTree> snap_tree;
+		std::future<std::shared_ptr<const PointKdTree>> snap_tree_future;
+		//corners added since then are kept in blocks of kd-trees, each block more than twice the size of the next (Bentley-Saxe)
+		//so there are O(log n) blocks and every corner is rebuilt O(log n) times, large merges run on a background thread
+		std::vector<sf::Vector2f> snap_pending_vec;				//corners not in snap_tree, from sequence number snap_pending_begin
+		std::size_t snap_pending_begin = 0;
+		std::size_t snap_pending_build_count = 0;				//part of snap_pending_vec included in snap_tree_future
+		std::size_t snap_pending_rebuild_count = 4096;
+		std::vector<SnapBlock> snap_block_vec;					//in sequence order, may overlap snap_tree
+		std::size_t snap_block_end = 0;							//corners from this sequence number are searched linearly
+		std::size_t snap_pending_linear_count = 256;			//longest linear part before it becomes a block
+		std::future<SnapBlock> snap_block_future;				//merge of the last two blocks before snap_block_merge_end
+		std::size_t snap_block_merge_end = 0;
+		std::size_t snap_block_sync_count = 4096;				//merges of more corners run on the background thread
+		bool snap_tree_stale = true;							//set when shapes are removed or changed
+		float snap_radius = 8.f;								//in pixels
+		bool snap_point_valid = false;
+		sf::Vector2f snap_point;
+		sf::Color snap_point_color = sf::Color::Red;
+		//edges of shapes near the snap point, indexed the first time so the outline fallback only tests edges near it
+		std::unordered_map<ShapeId, std::unique_ptr<OutlineSegmentIndex>> snap_outline_index_map;	//entries are erased when their shape changes
+		std::vector<wykobi::segment<float, 2>> snap_outline_segment_vec;		//edges of a shape too small to index
+		std::size_t snap_outline_index_min_count = 32;		//shapes with fewer edges are tested edge by edge
+		std::size_t snap_outline_index_max_count = 1024;	//indexed shapes kept, the map is cleared when full
 		
 		sf::VertexArray ui_vertex_array = sf::VertexArray(sf::Triangles);
 		std::vector<sf::Text> ui_text_vector;
 		float ui_border_thickness = 50.f;
 		sf::Color ui_border_color = sf::Color(129, 129, 129);
 
+		//borders and buttons are drawn into ui_texture, which is redrawn on resize or button state change
+		sf::RenderTexture ui_texture;
+		bool ui_texture_dirty = true;
+		bool ui_texture_valid = false;		//false if ui_texture could not be created, chrome is then drawn straight to window
+
 		sf::VertexArray diagram_vertex_array = sf::VertexArray(sf::Lines);
 		std::vector<sf::Text> diagram_text_vector;
 		sf::Color diagram_text_color = sf::Color::Black;
@@ -258,6 +751,11 @@ namespace GeometryDisplay {
 		wykobi::vector2d<float> diagram_line_resolution = wykobi::make_vector<float>(50.f, 50.f);
 		//sf::Vector2i line_screen_distance = { 50, 50 };
 		sf::Color diagram_line_color = { 0, 0, 255, 255 / 2 };
+		sf::Color diagram_minor_line_color = { 0, 0, 255, 255 / 6 };
+		sf::Vector2u diagram_major_line_ratio = { 1, 1 };	//every n-th line is major and labeled
+		bool auto_line_resolution = true;
+		float diagram_line_min_spacing = 20.f;				//pixels between minor lines
+		static const unsigned int max_diagram_line_count = 256;	//per axis, at any resolution
 
 		//mouse move
 		bool mouse_move = true;
@@ -269,9 +767,18 @@ namespace GeometryDisplay {
 		float mouse_zoom_amount = 1.1f;
 		bool mouse_middle_down = false;
 
+		//mouse moves and scroll steps are coalesced and applied once per batch of events
+		bool input_mouse_moved = false;
+		float input_zoom = 1.f;
+		sf::Vector2i input_zoom_pixel;
+
 		//show draw object name
 		bool show_draw_object_name = false;
 
+		//frame stats, recorded by window_thread
+		FrameStatsRecorder frame_stats_recorder;
+		bool show_frame_stats = false;
+
 		//lock scale
 		bool lock_world_view_scale = false;
 
@@ -287,8 +794,11 @@ namespace GeometryDisplay {
 		ToggleButton lock_world_view_scale_button;
 		ToggleButton mouse_move_button;
 		PushButton auto_size_button;
+		ToggleButton frame_stats_button;
 		PushButton make_polygon_button;
 		PushButton make_line_button;
+		ToggleButton select_button;
+		PushButton save_selection_button;
 
 		/*
 		Button member functions
@@ -300,7 +810,10 @@ namespace GeometryDisplay {
 		void buttonFunc_lock_world_view_scale(bool t);
 		void buttonFunc_mouse_move(bool t);
 		void buttonFunc_auto_size();
+		void buttonFunc_frame_stats(bool t);
 		void buttonFunc_make_polygon();
+		void buttonFunc_select(bool t);
+		void buttonFunc_save_selection();
 		//void buttonFunc_make_line();
 
 		/*
@@ -308,6 +821,53 @@ namespace GeometryDisplay {
 		*/
 		void windowHandler();
 
+		/*
+		Apply mouse move and zoom collected while polling events
+		Panning, snapping and hover picking run once for the last mouse position
+		*/
+		void applyCoalescedInput();
+
+		/*
+		Prep thread function
+		Prepares a frame from every new snapshot and hands it to window_thread
+		*/
+		void prepHandler();
+
+		/*
+		Tell prep_thread a new snapshot is published
+		*/
+		void wakePrepThread();
+
+		/*
+		Take latest frame from prep_thread and sort its new shapes into tiles
+		Must be called from window_thread
+		return:
+			true if there was a new frame
+		*/
+		bool takePreparedFrame();
+
+		/*
+		Wake window_thread
+		Safe to call from any thread
+		*/
+		void wake();
+
+		/*
+		Add Invalidation flags to the next frame
+		Does not wake window_thread
+		*/
+		void invalidate(unsigned int flags);
+
+		/*
+		Add Invalidation flags to the next frame and wake window_thread
+		*/
+		void requestFrame(unsigned int flags);
+
+		/*
+		Queue scene command and wake window_thread
+		*/
+		void pushSceneCommand(SceneCommand command);
+
 		/*
 		Update view
 		*/
@@ -315,28 +875,210 @@ namespace GeometryDisplay {
 
 		/*
 		Render diagram
+		rebuild:
+			false draws the lines and text of the last call
 		*/
-		void renderLines();
+		void renderLines(bool rebuild);
 
 		/*
 		Render UI
+		Redraws ui_texture if ui_texture_dirty, then draws it with one sprite
 		*/
 		void renderUI();
 
+		/*
+		Draw borders and buttons to target
+		*/
+		void drawUIChrome(sf::RenderTarget & target);
+
 		/*
 		Renders and displays next frame
 		Must be called from window_thread
+		rebuild_labels:
+			false draws the labels placed by the last call
 		*/
-		void renderDrawObject();
+		void renderDrawObject(bool rebuild_labels);
+
+		/*
+		Place names of shapes in draw_object_label_vec into draw_object_label_text_vec
+		Labels outside the diagram area or overlapping an earlier label are skipped
+		*/
+		void placeDrawObjectNames();
+
+		/*
+		Render outline of selected shapes and the rectangle being dragged
+		*/
+		void renderSelection();
+
+		/*
+		Get shapes overlapping region, in draw order
+		Candidates come from the spatial index, the exact test is split over threads when there are many
+		Must be called from window_thread, or with window_mutex held
+		*/
+		void queryDrawObject(const wykobi::polygon<float, 2> & region, std::vector<ShapeId> & out_vec);
+
+		/*
+		Write shapes in snapshot to file
+		id_set:
+			only write shapes with id in set, nullptr writes every shape
+		*/
+		void writeShapeFile(std::string path, const std::unordered_set<ShapeId>* id_set);
+
+		/*
+		Take finished snap tree and start a new build if needed
+		Must be called from window_thread
+		*/
+		void updateSnapTree();
+
+		/*
+		Start building snap tree from latest snapshot
+		*/
+		void startSnapTreeBuild();
+
+		/*
+		Move the linear part of snap_pending_vec into a block once it is longer than snap_pending_linear_count
+		and merge blocks, small merges on window_thread and one large merge at a time on a background thread
+		Keeps snapPixel bounded while a large snap tree is still building
+		*/
+		void updateSnapPendingTree();
+
+		/*
+		Build block of corners with sequence number begin to end
+		*/
+		SnapBlock makeSnapBlock(std::size_t begin, std::size_t end);
+
+		/*
+		Build block of the corners of a and b, which must be next to each other
+		Only reads a and b, so it can run on any thread
+		*/
+		static SnapBlock mergeSnapBlock(const SnapBlock & a, const SnapBlock & b);
+
+		/*
+		Snap pixel to closest scene corner, or closest outline if no corner is within snap_radius
+		return:
+			false if nothing is within snap_radius
+		*/
+		bool snapPixel(sf::Vector2i pixel, sf::Vector2f & out_point);
+
+		/*
+		Get closest point on outline of shape with id within max_distance
+		Edges of shapes with at least snap_outline_index_min_count edges are indexed the first time, later calls only test edges near point
+		return:
+			distance to out_point, infinity if no edge is within max_distance
+		*/
+		float closestOutlinePoint(ShapeId id, const DrawObject & shape, sf::Vector2f point, float max_distance, sf::Vector2f & out_point);
+
+		/*
+		Render marker at snap_point
+		*/
+		void renderSnapPoint();
+
+		/*
+		Render frame stats in the top right of the diagram area
+		*/
+		void renderFrameStats();
+
+		/*
+		Render tooltip for hover_shape_id
+		*/
+		void renderHoverInfo();
+
+		/*
+		Get topmost shape drawn at pixel
+		Must be called from window_thread, or with window_mutex held
+		return:
+			null_shape_id if there is no shape at pixel
+		*/
+		ShapeId pickDrawObject(sf::Vector2i pixel);
+
+		/*
+		Copy vertices of shape at index in prepared_frame to vertex_arr
+		*/
+		void appendDrawObjectVertexRange(std::size_t index, sf::VertexArray & vertex_arr);
+
+		/*
+		Get tile level for view_rect
+		Tiles are the smallest power of two at least draw_object_tile_min_size with draw_object_tile_axis_count across the view
+		*/
+		int getDrawObjectTileLevel(const wykobi::rectangle<float> & view_rect);
+
+		/*
+		Get world rectangle of tile
+		*/
+		static wykobi::rectangle<float> getDrawObjectTileRectangle(int level, std::int32_t tile_x, std::int32_t tile_y);
+
+		/*
+		Bring tile up to date with prepared_frame
+		Adds shapes added since it was last drawn and rebuilds its vertices if restyled
+		*/
+		void updateDrawObjectTile(DrawObjectTile & tile);
+
+		/*
+		Set view of window to world_view clipped to the pixels of tile_rect in diagram area
+		return:
+			false if tile_rect covers no pixel
+		*/
+		bool setDrawObjectTileView(const wykobi::rectangle<float> & tile_rect);
+
+		/*
+		Draw shapes of prepared_frame overlapping rect with the current view
+		Shapes are found through the frame index and drawn straight from its chunks in draw order
+		*/
+		void drawDrawObjectCulled(const wykobi::rectangle<float> & rect);
+
+		/*
+		Evict tiles more than one level from level or further than a view size from view_rect
+		Then evict least recently drawn tiles until at most draw_object_tile_max_cached_vertex_count are cached, tiles drawn this frame are kept
+		*/
+		void evictDrawObjectTiles(int level, const wykobi::rectangle<float> & view_rect);
+
+		/*
+		Get key of tile in draw_object_tile_map
+		*/
+		static std::uint64_t makeTileKey(int level, std::int32_t tile_x, std::int32_t tile_y);
+
+		/*
+		Get world rectangle shown in diagram area
+		*/
+		wykobi::rectangle<float> getWorldViewRectangle();
+
+		/*
+		Apply all queued scene commands as one batch
+		Must be called from window_thread
+		return:
+			true if the scene changed
+		*/
+		bool applySceneCommands();
+
+		/*
+		Convert shape to the storage used by this window
+		Called by producers before queueing
+		*/
+		std::shared_ptr<const DrawObject> makeStoredShape(std::shared_ptr<const DrawObject> shape);
+
+		/*
+		Share chunks of draw_object_vec with a new snapshot, swap it in and wake prep_thread
+		Must be called from window_thread
+		*/
+		void publishDrawObjectSnapshot();
+
+		/*
+		Get latest published snapshot
+		Never blocks
+		*/
+		std::shared_ptr<const DrawObjectSnapshot> getDrawObjectSnapshot();
 
 		/*
 		Auto size diagram
-		Based on shapes in window
+		Based on shapes in window, O(1) in shape count
+		Must be called from window_thread
 		*/
 		void autoSize();
 
 		/*
 		Auto line resolution
+		Picks 1, 2 or 5 times a power of ten from the world_view scale, so the number of lines is the same at every zoom
+		Does nothing if resolution was set with setDiagramLineResolution
 		*/
 		void autoLineResolution();
 		
@@ -365,11 +1107,55 @@ namespace GeometryDisplay {
 
 		/*
 		Append shape to window
+		Never blocks, the shape shows up when window_thread applies the next batch
+		return:
+			id of the new shape
+		*/
+		ShapeId addShape(DrawObject & shape);					//will clone shape
+		ShapeId addShape(std::unique_ptr<DrawObject> & ptr);	//will move ptr
+		ShapeId addShape(wykobi::polygon<float, 2> poly);
+		ShapeId addShape(wykobi::segment<float, 2> seg);
+
+		/*
+		Replace shape with id
+		Never blocks, unknown ids are ignored
+		*/
+		void updateShape(ShapeId id, DrawObject & shape);		//will clone shape
+
+		/*
+		Remove shape with id
+		Never blocks, unknown ids are ignored
+		*/
+		void removeShape(ShapeId id);
+
+		/*
+		Get topmost shape drawn at pixel
+		Candidates come from the spatial index, then get an exact test
+		Blocks until window_thread is done with the current frame, do not call from button functions
+		return:
+			null_shape_id if there is no shape at pixel
+		*/
+		ShapeId pickAt(sf::Vector2i pixel);
+
+		/*
+		Get shapes overlapping world rectangle or lasso polygon, in draw order
+		Blocks until window_thread is done with the current frame, do not call from button functions
 		*/
-		void addShape(DrawObject & shape);					//will clone shape
-		void addShape(std::unique_ptr<DrawObject> & ptr);	//will move ptr
-		void addShape(wykobi::polygon<float, 2> poly);
-		void addShape(wykobi::segment<float, 2> seg);
+		std::vector<ShapeId> queryRect(wykobi::rectangle<float> rect);
+		std::vector<ShapeId> queryPolygon(wykobi::polygon<float, 2> poly);
+
+		/*
+		Get shapes selected with select mode
+		*/
+		std::vector<ShapeId> getSelection();
+
+		/*
+		Draw every shape in this window with style id as style
+		Shapes keep id as their style class and are not copied, only prepared chunks using the class are tessellated again
+		Shapes added later with style id are drawn with style too, shapes in other windows keep their style
+		Id 0 is refused, it is the default of every shape
+		*/
+		void setStyle(StyleId id, const DrawStyle & style);
 
 		/*
 		Get screen view
@@ -383,6 +1169,7 @@ namespace GeometryDisplay {
 
 		/*
 		Clear shapes from window
+		Never blocks
 		*/
 		void clearShapeVec();
 
@@ -398,9 +1185,15 @@ namespace GeometryDisplay {
 
 		/*
 		Set diagram resolution
+		Turns off auto line resolution, every line is labeled
 		*/
 		void setDiagramLineResolution(float x, float y);
 
+		/*
+		Set if line resolution follows zoom
+		*/
+		void setAutoLineResolution(bool v);
+
 		/*
 		Set diagram position
 		*/
@@ -408,7 +1201,7 @@ namespace GeometryDisplay {
 
 		/*
 		Set update interval
-		In milliseconds
+		Shortest time between frames, in milliseconds
 		*/
 		void setUpdateInterval(int t);
 
@@ -432,6 +1225,30 @@ namespace GeometryDisplay {
 		*/
 		void setTitle(std::string title);
 
+		/*
+		Set detect instances
+		If true, loadShapeFromFile turns repeated polygons into InstanceShape
+		*/
+		void setDetectInstances(bool v);
+
+		/*
+		Set smallest world size of render tiles
+		Tiles are a power of two in size, chosen from the zoom
+		*/
+		void setTileSize(float size);
+
+		/*
+		Set compact storage
+		If true, polygons added afterwards are stored as CompactPolygonShape
+		error_bound is the largest distance a vertex may move, polygons that can not keep it are stored as they are
+		*/
+		void setCompactStorage(bool v, double error_bound);
+
+		/*
+		Get timings and counts of recent frames
+		*/
+		FrameStats getFrameStats();
+
 		/*
 		Get window size
 		*/
@@ -450,6 +1267,25 @@ namespace GeometryDisplay {
 		*/
 		void saveShapeToFile();
 		void saveShapeToFile(std::string path);
+		void saveShapeToFile(std::string path, const std::vector<ShapeId> & id_vec);
+
+		/*
+		Save selected shapes to file
+		(will promt dialog)
+		*/
+		void saveSelectionToFile();
+
+		/*
+		Save shapes to svg file
+		(will promt dialog)
+		view_only:
+			only shapes in the diagram area are written and the view becomes the svg viewBox
+			otherwise every shape is written, fitted to the size of the diagram area
+		min_pixel_size:
+			shapes smaller than this many svg pixels are skipped, 0 keeps every shape
+		*/
+		void saveSvgToFile();
+		void saveSvgToFile(std::string path, bool view_only, float min_pixel_size);
 
 					
 	};
@@ -459,7 +1295,7 @@ namespace GeometryDisplay {
 	Make two triangles representing a line with thickness
 	*/
 	std::vector<wykobi::triangle<float, 2>> makeTriangleLine(float x0, float y0, float x1, float y1, float thickness);
-	std::vector<wykobi::triangle<float, 2>> makeTriangleLine(wykobi::segment<float, 2> & seg, float thickness);
+	std::vector<wykobi::triangle<float, 2>> makeTriangleLine(const wykobi::segment<float, 2> & seg, float thickness);
 
 	/*
 	Make triangles representing point with radius
@@ -472,10 +1308,55 @@ namespace GeometryDisplay {
 	*/
 	float getClosestPointInRes(float v, float res);
 
+	/*
+	Get smallest 1, 2 or 5 times a power of ten not below min_resolution
+	out_major_ratio:
+		lines per major line, major lines also fall on 1, 2 or 5 times a power of ten
+	*/
+	float getNiceLineResolution(float min_resolution, unsigned int & out_major_ratio);
+
 	/*
 	Get smallest bounding rectangle
 	*/
-	wykobi::rectangle<float> getBoundingRectangle(wykobi::polygon<float, 2> & poly);
+	wykobi::rectangle<float> getBoundingRectangle(const wykobi::polygon<float, 2> & poly);
+
+	/*
+	Write color as svg paint attribute, followed by an opacity attribute if not opaque
+	name:
+		"fill" or "stroke"
+	*/
+	void writeSvgPaint(std::ostream & out, const char* name, sf::Color color);
+
+	/*
+	Write polygon as closed svg path element
+	*/
+	void writeSvgPolygon(std::ostream & out, const wykobi::polygon<float, 2> & poly, const DrawStyle & style, sf::Vector2f offset);
+
+	/*
+	Check if point is inside polygon
+	Uses even-odd rule
+	*/
+	bool pointInsidePolygon(sf::Vector2f point, const wykobi::polygon<float, 2> & poly);
+
+	/*
+	Get distance from point to closest point on segment
+	*/
+	float pointSegmentDistance(sf::Vector2f point, const wykobi::segment<float, 2> & seg);
+
+	/*
+	Get closest point on segment
+	*/
+	sf::Vector2f closestSegmentPoint(sf::Vector2f point, const wykobi::segment<float, 2> & seg);
+
+	/*
+	Make polygon with the corners of rectangle
+	*/
+	wykobi::polygon<float, 2> makeRectanglePolygon(const wykobi::rectangle<float> & rect);
+
+	/*
+	Check if two polygons overlap
+	*/
+	bool polygonIntersectPolygon(const wykobi::polygon<float, 2> & a, const wykobi::polygon<float, 2> & b);
 
 	/*
 	Check if segment is intersectiong polygon
@@ -539,6 +1420,83 @@ namespace GeometryDisplay {
 	wykobi::point2d<float> parsePoint(std::string str);
 	std::vector<wykobi::point2d<float>> parsePoints(std::string & str);
 
+	/*
+	Parse shapes from file
+	Shape lines with define_prototype=<name> declare a prototype instead of a shape
+	Lines with type=instance prototype=<name> offset=(x,y) place a copy of a prototype
+	detect_instances:
+		polygons with the same style whose vertices match another polygon after moving both to origin become InstanceShape
+		vertices are compared in steps of 1/1024, polygons that occur once are kept as they are
+	return:
+		false if the file could not be opened
+	*/
+	bool parseShapeFile(std::string path, bool detect_instances, std::vector<std::shared_ptr<const DrawObject>> & out_vec);
+
+	/*
+	Get world rectangle showing every shape, widened to the aspect ratio of size
+	*/
+	wykobi::rectangle<float> fitWorldRectangle(const std::vector<std::shared_ptr<const DrawObject>> & shape_vec, sf::Vector2u size);
+
+	/*
+	Rasterize shapes overlapping world_rect on the CPU, no window or GPU is needed
+	Shapes are tessellated with the same code as Window, split over threads
+	*/
+	void renderShapesToImage(const std::vector<std::shared_ptr<const DrawObject>> & shape_vec, const wykobi::rectangle<float> & world_rect, sf::Vector2u size, sf::Color background_color, sf::Image & out_image);
+
+	/*
+	Render shape file to image file without creating a window
+	Format is taken from the extension of image_path
+	world_rect:
+		rectangle with no area fits every shape
+	return:
+		false if the shape file could not be read or the image could not be written
+	*/
+	bool renderShapeFileToImage(std::string path, std::string image_path, sf::Vector2u size, wykobi::rectangle<float> world_rect);
+
+	/*
+	Stream shapes to svg file, one path at a time, so memory use does not grow with the number of shapes
+	world_rect becomes the viewBox and size the width and height of the svg
+	cull:
+		skip shapes outside world_rect
+	min_pixel_size:
+		skip shapes whose bounding rectangle is smaller than this many pixels on both axes, 0 keeps every shape
+	return:
+		false if the file could not be written
+	*/
+	bool writeSvgFile(std::string path, const std::vector<std::shared_ptr<const DrawObject>> & shape_vec, const wykobi::rectangle<float> & world_rect, sf::Vector2u size, bool cull, float min_pixel_size);
+
+	/*
+	Convert shape file to svg file without creating a window
+	world_rect:
+		rectangle with no area fits every shape
+	return:
+		false if the shape file could not be read or the svg could not be written
+	*/
+	bool renderShapeFileToSvg(std::string path, std::string svg_path, sf::Vector2u size, wykobi::rectangle<float> world_rect);
+
+	/*
+	Create directory, an existing directory counts as success
+	*/
+	bool makeDirectory(std::string path);
+
+	/*
+	Deepest level of exportTilePyramid, tile coordinates stay well inside 32 bits
+	*/
+	const unsigned int max_tile_pyramid_level = 30;
+
+	/*
+	Export deep zoom tile pyramid to out_dir/z/x/y.png without creating a window
+	Level z splits the square around world_rect into 2^z by 2^z tiles of tile_size pixels
+	Tiles are rendered in parallel, one tile per thread, starting from level 0
+	Only children of tiles with shapes are visited, tiles without shapes are not written
+	Shapes smaller than a pixel are not tessellated, their color and area are summed into one quad per pixel
+	max_level:
+		at most max_tile_pyramid_level
+	return:
+		false if max_level is too large or a tile could not be written
+	*/
+	bool exportTilePyramid(std::string out_dir, const std::vector<std::shared_ptr<const DrawObject>> & shape_vec, const wykobi::rectangle<float> & world_rect, unsigned int tile_size, unsigned int max_level, sf::Color background_color);
+
 }
 
 #endif // !GeometryDisplay_HEADER
@@ -0,0 +1,75 @@
+//Author: Sivert Andresen Cubedo
+
+#include "LabelGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace GeometryDisplay;
+
+void LabelGrid::reset(const sf::FloatRect & area, float cell_size) {
+	m_area = area;
+	m_cell_size = std::max(cell_size, 1.f);
+	m_column_count = std::max(1, static_cast<int>(std::ceil(area.width / m_cell_size)));
+	m_row_count = std::max(1, static_cast<int>(std::ceil(area.height / m_cell_size)));
+	std::size_t cell_count = static_cast<std::size_t>(m_column_count) * static_cast<std::size_t>(m_row_count);
+	if (m_cell_vec.size() < cell_count) {
+		m_cell_vec.resize(cell_count);
+	}
+	for (std::size_t i = 0; i < cell_count; ++i) {
+		m_cell_vec[i].clear();
+	}
+}
+
+bool LabelGrid::overlaps(const sf::FloatRect & rect) const {
+	int x0, y0, x1, y1;
+	if (!cellRange(rect, x0, y0, x1, y1)) {
+		return true;
+	}
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			for (const sf::FloatRect & other : m_cell_vec[y * m_column_count + x]) {
+				if (rect.intersects(other)) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+void LabelGrid::insert(const sf::FloatRect & rect) {
+	int x0, y0, x1, y1;
+	if (!cellRange(rect, x0, y0, x1, y1)) {
+		return;
+	}
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			m_cell_vec[y * m_column_count + x].push_back(rect);
+		}
+	}
+}
+
+bool LabelGrid::tryInsert(const sf::FloatRect & rect) {
+	if (overlaps(rect)) {
+		return false;
+	}
+	insert(rect);
+	return true;
+}
+
+bool LabelGrid::cellRange(const sf::FloatRect & rect, int & x0, int & y0, int & x1, int & y1) const {
+	if (rect.left < m_area.left || rect.top < m_area.top ||
+		rect.left + rect.width > m_area.left + m_area.width ||
+		rect.top + rect.height > m_area.top + m_area.height) {
+		return false;
+	}
+	x0 = static_cast<int>((rect.left - m_area.left) / m_cell_size);
+	y0 = static_cast<int>((rect.top - m_area.top) / m_cell_size);
+	x1 = std::min(m_column_count - 1, static_cast<int>((rect.left + rect.width - m_area.left) / m_cell_size));
+	y1 = std::min(m_row_count - 1, static_cast<int>((rect.top + rect.height - m_area.top) / m_cell_size));
+	return true;
+}
+
+
+//end
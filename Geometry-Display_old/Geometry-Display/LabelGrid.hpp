@@ -0,0 +1,60 @@
+//Author: Sivert Andresen Cubedo
+#pragma once
+
+#ifndef LabelGrid_HEADER
+#define LabelGrid_HEADER
+
+#include <vector>
+
+#include <SFML\Graphics.hpp>
+
+namespace GeometryDisplay {
+	/*
+	Uniform grid of screen rectangles used to place labels without overlap
+	Cells keep their memory between frames
+	*/
+	class LabelGrid {
+	public:
+		/*
+		Remove all rectangles and cover area with cells of cell_size pixels
+		*/
+		void reset(const sf::FloatRect & area, float cell_size);
+
+		/*
+		Check if rect overlaps a rectangle in grid
+		Rectangles outside area always overlap
+		*/
+		bool overlaps(const sf::FloatRect & rect) const;
+
+		/*
+		Add rect to grid
+		*/
+		void insert(const sf::FloatRect & rect);
+
+		/*
+		Add rect to grid if it does not overlap
+		return:
+			true if rect was added
+		*/
+		bool tryInsert(const sf::FloatRect & rect);
+
+	private:
+		sf::FloatRect m_area;
+		float m_cell_size = 1.f;
+		int m_column_count = 0;
+		int m_row_count = 0;
+		std::vector<std::vector<sf::FloatRect>> m_cell_vec;
+
+		/*
+		Get range of cells covered by rect
+		return:
+			false if rect is not fully inside area
+		*/
+		bool cellRange(const sf::FloatRect & rect, int & x0, int & y0, int & x1, int & y1) const;
+	};
+}
+
+#endif // !LabelGrid_HEADER
+
+
+//end
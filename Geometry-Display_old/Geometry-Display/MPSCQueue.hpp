@@ -0,0 +1,93 @@
+//Author: Sivert Andresen Cubedo
+#pragma once
+
+#ifndef MPSCQueue_HEADER
+#define MPSCQueue_HEADER
+
+#include <atomic>
+#include <vector>
+#include <utility>
+
+namespace GeometryDisplay {
+	/*
+	Lock-free multiple producer single consumer queue
+	Any thread can push, one thread drains everything queued so far in one go
+	*/
+	template <typename T>
+	class MPSCQueue {
+	private:
+		struct Node {
+			T value;
+			Node* next;
+		};
+
+		std::atomic<Node*> m_head{ nullptr };
+
+	public:
+		MPSCQueue() = default;
+		MPSCQueue(const MPSCQueue &) = delete;
+		MPSCQueue & operator=(const MPSCQueue &) = delete;
+
+		/*
+		Destructor
+		Deletes values that were never drained
+		*/
+		~MPSCQueue() {
+			Node* node = m_head.exchange(nullptr, std::memory_order_acquire);
+			while (node != nullptr) {
+				Node* next = node->next;
+				delete node;
+				node = next;
+			}
+		}
+
+		/*
+		Push value
+		Never blocks, safe to call from any thread
+		*/
+		void push(T value) {
+			Node* node = new Node{ std::move(value), m_head.load(std::memory_order_relaxed) };
+			while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		/*
+		Move every queued value to the back of out_vec, oldest first
+		Only one thread may drain at a time
+		return:
+			number of values moved
+		*/
+		std::size_t drain(std::vector<T> & out_vec) {
+			Node* node = m_head.exchange(nullptr, std::memory_order_acquire);
+			//list is newest first, reverse it to get push order
+			Node* reversed = nullptr;
+			while (node != nullptr) {
+				Node* next = node->next;
+				node->next = reversed;
+				reversed = node;
+				node = next;
+			}
+			std::size_t count = 0;
+			while (reversed != nullptr) {
+				Node* next = reversed->next;
+				out_vec.push_back(std::move(reversed->value));
+				delete reversed;
+				reversed = next;
+				++count;
+			}
+			return count;
+		}
+
+		/*
+		Check if queue is empty
+		Only a hint when producers are active
+		*/
+		bool empty() const {
+			return m_head.load(std::memory_order_relaxed) == nullptr;
+		}
+	};
+}
+
+#endif // !MPSCQueue_HEADER
+
+
+//end
@@ -0,0 +1,76 @@
+//Author: Sivert Andresen Cubedo
+
+#include "PointKdTree.hpp"
+
+#include <algorithm>
+
+using namespace GeometryDisplay;
+
+PointKdTree::PointKdTree(std::vector<sf::Vector2f> point_vec) :
+	m_point_vec(std::move(point_vec))
+{
+	build(0, m_point_vec.size(), 0);
+}
+
+bool PointKdTree::nearest(sf::Vector2f point, float max_distance, sf::Vector2f & out_point) const {
+	float best_distance_sq = max_distance * max_distance;
+	std::size_t best_index = m_point_vec.size();
+	nearest(0, m_point_vec.size(), 0, point, best_distance_sq, best_index);
+	if (best_index == m_point_vec.size()) {
+		return false;
+	}
+	out_point = m_point_vec[best_index];
+	return true;
+}
+
+std::size_t PointKdTree::size() const {
+	return m_point_vec.size();
+}
+
+const std::vector<sf::Vector2f> & PointKdTree::getPoints() const {
+	return m_point_vec;
+}
+
+void PointKdTree::build(std::size_t begin, std::size_t end, int axis) {
+	if (end - begin < 2) {
+		return;
+	}
+	std::size_t mid = begin + (end - begin) / 2;
+	std::nth_element(m_point_vec.begin() + begin, m_point_vec.begin() + mid, m_point_vec.begin() + end, [axis](const sf::Vector2f & a, const sf::Vector2f & b) {
+		return (axis == 0) ? a.x < b.x : a.y < b.y;
+	});
+	build(begin, mid, 1 - axis);
+	build(mid + 1, end, 1 - axis);
+}
+
+void PointKdTree::nearest(std::size_t begin, std::size_t end, int axis, sf::Vector2f point, float & best_distance_sq, std::size_t & best_index) const {
+	if (begin >= end) {
+		return;
+	}
+	std::size_t mid = begin + (end - begin) / 2;
+	const sf::Vector2f & node = m_point_vec[mid];
+	float dx = node.x - point.x;
+	float dy = node.y - point.y;
+	float distance_sq = dx * dx + dy * dy;
+	if (distance_sq <= best_distance_sq) {
+		best_distance_sq = distance_sq;
+		best_index = mid;
+	}
+	//search the side containing point first, the other side only if the split is close enough
+	float split = (axis == 0) ? point.x - node.x : point.y - node.y;
+	if (split < 0.f) {
+		nearest(begin, mid, 1 - axis, point, best_distance_sq, best_index);
+		if (split * split <= best_distance_sq) {
+			nearest(mid + 1, end, 1 - axis, point, best_distance_sq, best_index);
+		}
+	}
+	else {
+		nearest(mid + 1, end, 1 - axis, point, best_distance_sq, best_index);
+		if (split * split <= best_distance_sq) {
+			nearest(begin, mid, 1 - axis, point, best_distance_sq, best_index);
+		}
+	}
+}
+
+
+//end
@@ -0,0 +1,55 @@
+//Author: Sivert Andresen Cubedo
+#pragma once
+
+#ifndef PointKdTree_HEADER
+#define PointKdTree_HEADER
+
+#include <vector>
+#include <cstddef>
+
+#include <SFML\Graphics.hpp>
+
+namespace GeometryDisplay {
+	/*
+	Static 2d kd-tree over points
+	Stored implicitly, the median of each range is its node and the split axis alternates with depth
+	Build is O(n log n), nearest point query is O(log n) on average
+	*/
+	class PointKdTree {
+	public:
+		PointKdTree() = default;
+
+		/*
+		Build tree from points
+		*/
+		explicit PointKdTree(std::vector<sf::Vector2f> point_vec);
+
+		/*
+		Find point closest to point
+		return:
+			false if no point is within max_distance
+		*/
+		bool nearest(sf::Vector2f point, float max_distance, sf::Vector2f & out_point) const;
+
+		/*
+		Number of points
+		*/
+		std::size_t size() const;
+
+		/*
+		Get points, in tree order
+		*/
+		const std::vector<sf::Vector2f> & getPoints() const;
+
+	private:
+		std::vector<sf::Vector2f> m_point_vec;
+
+		void build(std::size_t begin, std::size_t end, int axis);
+		void nearest(std::size_t begin, std::size_t end, int axis, sf::Vector2f point, float & best_distance_sq, std::size_t & best_index) const;
+	};
+}
+
+#endif // !PointKdTree_HEADER
+
+
+//end
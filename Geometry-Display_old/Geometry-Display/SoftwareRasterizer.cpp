@@ -0,0 +1,221 @@
+//Author: Sivert Andresen Cubedo
+
+#include "SoftwareRasterizer.hpp"
+
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+using namespace GeometryDisplay;
+
+const unsigned int SoftwareRasterizer::band_row_count;
+
+SoftwareRasterizer::SoftwareRasterizer(sf::Vector2u size, const wykobi::rectangle<float> & world_rect) :
+	m_size(size),
+	m_world_rect(world_rect),
+	m_pixel_vec(static_cast<std::size_t>(size.x) * size.y * 4, 0.f)
+{
+	float world_width = world_rect[1].x - world_rect[0].x;
+	float world_height = world_rect[1].y - world_rect[0].y;
+	m_scale.x = (world_width != 0.f) ? static_cast<float>(size.x) / world_width : 0.f;
+	m_scale.y = (world_height != 0.f) ? static_cast<float>(size.y) / world_height : 0.f;
+}
+
+void SoftwareRasterizer::setSampleCount(unsigned int count) {
+	m_sample_count = std::max(1u, count);
+}
+
+void SoftwareRasterizer::clear(sf::Color color) {
+	float a = color.a / 255.f;
+	float rgba[4] = { color.r / 255.f * a, color.g / 255.f * a, color.b / 255.f * a, a };
+	for (std::size_t i = 0; i < m_pixel_vec.size(); ++i) {
+		m_pixel_vec[i] = rgba[i % 4];
+	}
+}
+
+void SoftwareRasterizer::draw(const sf::VertexArray & vertex_arr) {
+	draw(vertex_arr, 0, vertex_arr.getVertexCount());
+}
+
+void SoftwareRasterizer::draw(const sf::VertexArray & vertex_arr, std::size_t begin, std::size_t end) {
+	//layers never reach into the previous shape
+	bool new_shape = true;
+	for (std::size_t i = begin; i + 2 < end; i += 3) {
+		Triangle tri;
+		for (std::size_t j = 0; j < 3; ++j) {
+			const sf::Vector2f & position = vertex_arr[i + j].position;
+			tri.point_arr[j].x = (position.x - m_world_rect[0].x) * m_scale.x;
+			tri.point_arr[j].y = (position.y - m_world_rect[0].y) * m_scale.y;
+		}
+		float min_x = std::min({ tri.point_arr[0].x, tri.point_arr[1].x, tri.point_arr[2].x });
+		float max_x = std::max({ tri.point_arr[0].x, tri.point_arr[1].x, tri.point_arr[2].x });
+		tri.min_y = std::min({ tri.point_arr[0].y, tri.point_arr[1].y, tri.point_arr[2].y });
+		tri.max_y = std::max({ tri.point_arr[0].y, tri.point_arr[1].y, tri.point_arr[2].y });
+		const sf::Color & color = vertex_arr[i].color;
+		if (max_x <= 0.f || min_x >= static_cast<float>(m_size.x) || tri.max_y <= 0.f || tri.min_y >= static_cast<float>(m_size.y) || color.a == 0) {
+			continue;
+		}
+		if (new_shape || !(m_layer_vec.back().color == color)) {
+			new_shape = false;
+			Layer layer;
+			layer.begin = m_triangle_vec.size();
+			layer.end = layer.begin;
+			layer.color = color;
+			layer.min_x = min_x;
+			layer.min_y = tri.min_y;
+			layer.max_x = max_x;
+			layer.max_y = tri.max_y;
+			m_layer_vec.push_back(layer);
+		}
+		Layer & layer = m_layer_vec.back();
+		layer.min_x = std::min(layer.min_x, min_x);
+		layer.min_y = std::min(layer.min_y, tri.min_y);
+		layer.max_x = std::max(layer.max_x, max_x);
+		layer.max_y = std::max(layer.max_y, tri.max_y);
+		m_triangle_vec.push_back(tri);
+		layer.end = m_triangle_vec.size();
+	}
+}
+
+void SoftwareRasterizer::render(unsigned int thread_count) {
+	if (thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+	unsigned int band_count = (m_size.y + band_row_count - 1) / band_row_count;
+	thread_count = std::min(thread_count, std::max(1u, band_count));
+	//bands are handed out one at a time, so threads stay busy when some bands hold more shapes
+	std::atomic<unsigned int> next_band{ 0 };
+	auto work = [&]() {
+		std::vector<float> coverage_vec(static_cast<std::size_t>(m_size.x) * band_row_count, 0.f);
+		for (unsigned int band = next_band++; band < band_count; band = next_band++) {
+			unsigned int row_begin = band * band_row_count;
+			renderBand(row_begin, std::min(row_begin + band_row_count, m_size.y), coverage_vec);
+		}
+	};
+	std::vector<std::thread> thread_vec;
+	for (unsigned int i = 1; i < thread_count; ++i) {
+		thread_vec.emplace_back(work);
+	}
+	work();
+	for (std::thread & t : thread_vec) {
+		t.join();
+	}
+	m_triangle_vec.clear();
+	m_layer_vec.clear();
+}
+
+void SoftwareRasterizer::renderBand(unsigned int row_begin, unsigned int row_end, std::vector<float> & coverage_vec) {
+	int width = static_cast<int>(m_size.x);
+	float band_top = static_cast<float>(row_begin);
+	float band_bottom = static_cast<float>(row_end);
+	float weight = 1.f / static_cast<float>(m_sample_count);
+	for (const Layer & layer : m_layer_vec) {
+		if (layer.max_y <= band_top || layer.min_y >= band_bottom) {
+			continue;
+		}
+		//accumulate coverage of every triangle in layer
+		for (std::size_t t = layer.begin; t < layer.end; ++t) {
+			const Triangle & tri = m_triangle_vec[t];
+			if (tri.max_y <= band_top || tri.min_y >= band_bottom) {
+				continue;
+			}
+			unsigned int tri_row_begin = std::max(row_begin, static_cast<unsigned int>(std::max(0.f, std::floor(tri.min_y))));
+			unsigned int tri_row_end = std::min(row_end, static_cast<unsigned int>(std::max(0.f, std::ceil(tri.max_y))));
+			for (unsigned int row = tri_row_begin; row < tri_row_end; ++row) {
+				float* coverage_row = &coverage_vec[static_cast<std::size_t>(row - row_begin) * m_size.x];
+				for (unsigned int s = 0; s < m_sample_count; ++s) {
+					float y = static_cast<float>(row) + (static_cast<float>(s) + 0.5f) * weight;
+					float x0 = 0.f;
+					float x1 = 0.f;
+					int hit_count = 0;
+					for (int e = 0; e < 3; ++e) {
+						const sf::Vector2f & a = tri.point_arr[e];
+						const sf::Vector2f & b = tri.point_arr[(e + 1) % 3];
+						//half open so a vertex on the scanline is only counted once
+						if ((a.y <= y && y < b.y) || (b.y <= y && y < a.y)) {
+							float x = a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y);
+							if (hit_count == 0) {
+								x0 = x;
+								x1 = x;
+							}
+							else {
+								x0 = std::min(x0, x);
+								x1 = std::max(x1, x);
+							}
+							++hit_count;
+						}
+					}
+					if (hit_count >= 2) {
+						addSpan(coverage_row, width, x0, x1, weight);
+					}
+				}
+			}
+		}
+		//blend layer over image and clear the coverage it used
+		int x_begin = std::max(0, static_cast<int>(std::floor(layer.min_x)));
+		int x_end = std::min(width, static_cast<int>(std::ceil(layer.max_x)) + 1);
+		unsigned int layer_row_begin = std::max(row_begin, static_cast<unsigned int>(std::max(0.f, std::floor(layer.min_y))));
+		unsigned int layer_row_end = std::min(row_end, static_cast<unsigned int>(std::max(0.f, std::ceil(layer.max_y))));
+		float color_alpha = layer.color.a / 255.f;
+		float color_arr[3] = { layer.color.r / 255.f, layer.color.g / 255.f, layer.color.b / 255.f };
+		for (unsigned int row = layer_row_begin; row < layer_row_end; ++row) {
+			float* coverage_row = &coverage_vec[static_cast<std::size_t>(row - row_begin) * m_size.x];
+			float* pixel_row = &m_pixel_vec[static_cast<std::size_t>(row) * m_size.x * 4];
+			for (int x = x_begin; x < x_end; ++x) {
+				float coverage = coverage_row[x];
+				if (coverage <= 0.f) {
+					continue;
+				}
+				coverage_row[x] = 0.f;
+				float a = std::min(coverage, 1.f) * color_alpha;
+				float* pixel = pixel_row + x * 4;
+				pixel[0] = color_arr[0] * a + pixel[0] * (1.f - a);
+				pixel[1] = color_arr[1] * a + pixel[1] * (1.f - a);
+				pixel[2] = color_arr[2] * a + pixel[2] * (1.f - a);
+				pixel[3] = a + pixel[3] * (1.f - a);
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::addSpan(float* row, int width, float x0, float x1, float weight) {
+	x0 = std::max(x0, 0.f);
+	x1 = std::min(x1, static_cast<float>(width));
+	if (x1 <= x0) {
+		return;
+	}
+	int i0 = static_cast<int>(x0);
+	int i1 = static_cast<int>(x1);
+	if (i0 == i1) {
+		row[i0] += (x1 - x0) * weight;
+		return;
+	}
+	row[i0] += (static_cast<float>(i0 + 1) - x0) * weight;
+	for (int i = i0 + 1; i < i1; ++i) {
+		row[i] += weight;
+	}
+	if (i1 < width) {
+		row[i1] += (x1 - static_cast<float>(i1)) * weight;
+	}
+}
+
+void SoftwareRasterizer::copyToImage(sf::Image & out_image) const {
+	std::vector<sf::Uint8> byte_vec(m_pixel_vec.size());
+	for (std::size_t i = 0; i < m_pixel_vec.size(); i += 4) {
+		float a = m_pixel_vec[i + 3];
+		float unpremultiply = (a > 0.f) ? 1.f / a : 0.f;
+		for (std::size_t c = 0; c < 3; ++c) {
+			byte_vec[i + c] = static_cast<sf::Uint8>(std::min(1.f, m_pixel_vec[i + c] * unpremultiply) * 255.f + 0.5f);
+		}
+		byte_vec[i + 3] = static_cast<sf::Uint8>(std::min(1.f, a) * 255.f + 0.5f);
+	}
+	out_image.create(m_size.x, m_size.y, byte_vec.data());
+}
+
+sf::Vector2u SoftwareRasterizer::getSize() const {
+	return m_size;
+}
+
+
+//end
@@ -0,0 +1,110 @@
+//Author: Sivert Andresen Cubedo
+#pragma once
+
+#ifndef SoftwareRasterizer_HEADER
+#define SoftwareRasterizer_HEADER
+
+#include <vector>
+#include <cstddef>
+
+#include <SFML\Graphics.hpp>
+
+#include <wykobi.hpp>
+
+namespace GeometryDisplay {
+	/*
+	CPU rasterizer for triangle vertex arrays, needs no window or GPU
+	Rows are split into bands rasterized in parallel
+	Each pixel row is sampled with sample_count sub scanlines, coverage along a sub scanline is exact
+	Consecutive triangles of one color in one shape are blended as one layer, so shared edges of a tessellated shape do not show seams
+	Separate shapes are always separate layers, so translucent shapes of one color still blend over each other
+	*/
+	class SoftwareRasterizer {
+	public:
+		/*
+		Constructor
+		world_rect is mapped onto the image, top left corner to pixel (0, 0)
+		*/
+		SoftwareRasterizer(sf::Vector2u size, const wykobi::rectangle<float> & world_rect);
+
+		/*
+		Set sub scanlines per pixel row
+		*/
+		void setSampleCount(unsigned int count);
+
+		/*
+		Fill image with color
+		*/
+		void clear(sf::Color color);
+
+		/*
+		Queue triangles in world coordinates as one shape
+		Colors are taken from the first vertex of each triangle
+		*/
+		void draw(const sf::VertexArray & vertex_arr);
+
+		/*
+		Queue vertices [begin, end) of vertex_arr as one shape
+		*/
+		void draw(const sf::VertexArray & vertex_arr, std::size_t begin, std::size_t end);
+
+		/*
+		Rasterize and empty the queue
+		thread_count:
+			0 uses one thread per core
+		*/
+		void render(unsigned int thread_count = 0);
+
+		/*
+		Copy image to out_image
+		*/
+		void copyToImage(sf::Image & out_image) const;
+
+		/*
+		Get image size
+		*/
+		sf::Vector2u getSize() const;
+
+	private:
+		struct Triangle {
+			sf::Vector2f point_arr[3];		//in pixels
+			float min_y;
+			float max_y;
+		};
+		struct Layer {
+			std::size_t begin;				//range in m_triangle_vec
+			std::size_t end;
+			sf::Color color;
+			float min_x;
+			float min_y;
+			float max_x;
+			float max_y;
+		};
+
+		static const unsigned int band_row_count = 16;
+
+		sf::Vector2u m_size;
+		wykobi::rectangle<float> m_world_rect;
+		sf::Vector2f m_scale;
+		unsigned int m_sample_count = 4;
+		std::vector<float> m_pixel_vec;		//premultiplied rgba, 0 to 1
+		std::vector<Triangle> m_triangle_vec;
+		std::vector<Layer> m_layer_vec;
+
+		/*
+		Rasterize rows [row_begin, row_end)
+		coverage_vec is scratch memory of band_row_count rows
+		*/
+		void renderBand(unsigned int row_begin, unsigned int row_end, std::vector<float> & coverage_vec);
+
+		/*
+		Add coverage of span [x0, x1) times weight to row
+		*/
+		static void addSpan(float* row, int width, float x0, float x1, float weight);
+	};
+}
+
+#endif // !SoftwareRasterizer_HEADER
+
+
+//end
@@ -0,0 +1,321 @@
+//Author: Sivert Andresen Cubedo
+
+#include "SpatialIndex.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace GeometryDisplay;
+
+void SpatialIndex::insert(std::size_t id, const wykobi::rectangle<float> & rect) {
+	remove(id);
+	int leaf = allocateNode();
+	m_node_vec[leaf].rect = normalizeRectangle(rect);
+	m_node_vec[leaf].id = id;
+	m_node_vec[leaf].height = 0;
+	insertLeaf(leaf);
+	m_leaf_map[id] = leaf;
+}
+
+void SpatialIndex::remove(std::size_t id) {
+	auto it = m_leaf_map.find(id);
+	if (it == m_leaf_map.end()) {
+		return;
+	}
+	int leaf = it->second;
+	m_leaf_map.erase(it);
+	removeLeaf(leaf);
+	freeNode(leaf);
+}
+
+void SpatialIndex::clear() {
+	m_node_vec.clear();
+	m_free_vec.clear();
+	m_leaf_map.clear();
+	m_root = null_node;
+}
+
+std::size_t SpatialIndex::size() const {
+	return m_leaf_map.size();
+}
+
+bool SpatialIndex::getRectangle(std::size_t id, wykobi::rectangle<float> & out_rect) const {
+	auto it = m_leaf_map.find(id);
+	if (it == m_leaf_map.end()) {
+		return false;
+	}
+	out_rect = m_node_vec[it->second].rect;
+	return true;
+}
+
+bool SpatialIndex::getBoundingRectangle(wykobi::rectangle<float> & out_rect) const {
+	if (m_root == null_node) {
+		return false;
+	}
+	out_rect = m_node_vec[m_root].rect;
+	return true;
+}
+
+void SpatialIndex::query(const wykobi::rectangle<float> & rect, std::vector<std::size_t> & out_vec) const {
+	query(rect, [&](std::size_t id) {
+		out_vec.push_back(id);
+		return true;
+	});
+}
+
+wykobi::rectangle<float> SpatialIndex::normalizeRectangle(const wykobi::rectangle<float> & rect) {
+	return wykobi::make_rectangle<float>(
+		std::min(rect[0].x, rect[1].x),
+		std::min(rect[0].y, rect[1].y),
+		std::max(rect[0].x, rect[1].x),
+		std::max(rect[0].y, rect[1].y)
+	);
+}
+
+bool SpatialIndex::rectangleIntersect(const wykobi::rectangle<float> & a, const wykobi::rectangle<float> & b) {
+	return a[0].x <= b[1].x && b[0].x <= a[1].x && a[0].y <= b[1].y && b[0].y <= a[1].y;
+}
+
+int SpatialIndex::allocateNode() {
+	if (m_free_vec.empty()) {
+		m_node_vec.push_back(Node());
+		return static_cast<int>(m_node_vec.size()) - 1;
+	}
+	int node_index = m_free_vec.back();
+	m_free_vec.pop_back();
+	m_node_vec[node_index] = Node();
+	return node_index;
+}
+
+void SpatialIndex::freeNode(int node_index) {
+	m_node_vec[node_index].height = -1;
+	m_free_vec.push_back(node_index);
+}
+
+void SpatialIndex::insertLeaf(int leaf) {
+	if (m_root == null_node) {
+		m_root = leaf;
+		m_node_vec[m_root].parent = null_node;
+		return;
+	}
+
+	//find best sibling, descend toward the child whose perimeter grows the least
+	wykobi::rectangle<float> leaf_rect = m_node_vec[leaf].rect;
+	int index = m_root;
+	while (!m_node_vec[index].isLeaf()) {
+		int child_1 = m_node_vec[index].child_1;
+		int child_2 = m_node_vec[index].child_2;
+
+		float node_perimeter = perimeter(m_node_vec[index].rect);
+		float combined_perimeter = perimeter(combine(m_node_vec[index].rect, leaf_rect));
+
+		//cost of making a new parent for this node and the new leaf
+		float cost = 2.f * combined_perimeter;
+		//minimum cost of pushing the leaf further down the tree
+		float inheritance_cost = 2.f * (combined_perimeter - node_perimeter);
+
+		float cost_1 = perimeter(combine(leaf_rect, m_node_vec[child_1].rect)) + inheritance_cost;
+		if (!m_node_vec[child_1].isLeaf()) {
+			cost_1 -= perimeter(m_node_vec[child_1].rect);
+		}
+		float cost_2 = perimeter(combine(leaf_rect, m_node_vec[child_2].rect)) + inheritance_cost;
+		if (!m_node_vec[child_2].isLeaf()) {
+			cost_2 -= perimeter(m_node_vec[child_2].rect);
+		}
+
+		if (cost < cost_1 && cost < cost_2) {
+			break;
+		}
+		index = (cost_1 < cost_2) ? child_1 : child_2;
+	}
+	int sibling = index;
+
+	//make new parent
+	int old_parent = m_node_vec[sibling].parent;
+	int new_parent = allocateNode();
+	m_node_vec[new_parent].parent = old_parent;
+	m_node_vec[new_parent].rect = combine(leaf_rect, m_node_vec[sibling].rect);
+	m_node_vec[new_parent].height = m_node_vec[sibling].height + 1;
+	m_node_vec[new_parent].child_1 = sibling;
+	m_node_vec[new_parent].child_2 = leaf;
+	m_node_vec[sibling].parent = new_parent;
+	m_node_vec[leaf].parent = new_parent;
+	if (old_parent != null_node) {
+		if (m_node_vec[old_parent].child_1 == sibling) {
+			m_node_vec[old_parent].child_1 = new_parent;
+		}
+		else {
+			m_node_vec[old_parent].child_2 = new_parent;
+		}
+	}
+	else {
+		m_root = new_parent;
+	}
+
+	//walk back up fixing heights and rectangles
+	index = m_node_vec[leaf].parent;
+	while (index != null_node) {
+		index = balance(index);
+		int child_1 = m_node_vec[index].child_1;
+		int child_2 = m_node_vec[index].child_2;
+		m_node_vec[index].height = 1 + std::max(m_node_vec[child_1].height, m_node_vec[child_2].height);
+		m_node_vec[index].rect = combine(m_node_vec[child_1].rect, m_node_vec[child_2].rect);
+		index = m_node_vec[index].parent;
+	}
+}
+
+void SpatialIndex::removeLeaf(int leaf) {
+	if (leaf == m_root) {
+		m_root = null_node;
+		return;
+	}
+	int parent = m_node_vec[leaf].parent;
+	int grand_parent = m_node_vec[parent].parent;
+	int sibling = (m_node_vec[parent].child_1 == leaf) ? m_node_vec[parent].child_2 : m_node_vec[parent].child_1;
+
+	if (grand_parent != null_node) {
+		//replace parent with sibling
+		if (m_node_vec[grand_parent].child_1 == parent) {
+			m_node_vec[grand_parent].child_1 = sibling;
+		}
+		else {
+			m_node_vec[grand_parent].child_2 = sibling;
+		}
+		m_node_vec[sibling].parent = grand_parent;
+		freeNode(parent);
+
+		int index = grand_parent;
+		while (index != null_node) {
+			index = balance(index);
+			int child_1 = m_node_vec[index].child_1;
+			int child_2 = m_node_vec[index].child_2;
+			m_node_vec[index].rect = combine(m_node_vec[child_1].rect, m_node_vec[child_2].rect);
+			m_node_vec[index].height = 1 + std::max(m_node_vec[child_1].height, m_node_vec[child_2].height);
+			index = m_node_vec[index].parent;
+		}
+	}
+	else {
+		m_root = sibling;
+		m_node_vec[sibling].parent = null_node;
+		freeNode(parent);
+	}
+}
+
+int SpatialIndex::balance(int a_index) {
+	//rotate a child up if the subtree heights differ by more than one
+	Node & a = m_node_vec[a_index];
+	if (a.isLeaf() || a.height < 2) {
+		return a_index;
+	}
+	int b_index = a.child_1;
+	int c_index = a.child_2;
+	int diff = m_node_vec[c_index].height - m_node_vec[b_index].height;
+
+	if (diff > 1) {
+		//rotate c up
+		Node & c = m_node_vec[c_index];
+		int f_index = c.child_1;
+		int g_index = c.child_2;
+
+		c.child_1 = a_index;
+		c.parent = a.parent;
+		a.parent = c_index;
+		if (c.parent != null_node) {
+			if (m_node_vec[c.parent].child_1 == a_index) {
+				m_node_vec[c.parent].child_1 = c_index;
+			}
+			else {
+				m_node_vec[c.parent].child_2 = c_index;
+			}
+		}
+		else {
+			m_root = c_index;
+		}
+
+		Node & b = m_node_vec[b_index];
+		Node & f = m_node_vec[f_index];
+		Node & g = m_node_vec[g_index];
+		if (f.height > g.height) {
+			c.child_2 = f_index;
+			a.child_2 = g_index;
+			g.parent = a_index;
+			a.rect = combine(b.rect, g.rect);
+			c.rect = combine(a.rect, f.rect);
+			a.height = 1 + std::max(b.height, g.height);
+			c.height = 1 + std::max(a.height, f.height);
+		}
+		else {
+			c.child_2 = g_index;
+			a.child_2 = f_index;
+			f.parent = a_index;
+			a.rect = combine(b.rect, f.rect);
+			c.rect = combine(a.rect, g.rect);
+			a.height = 1 + std::max(b.height, f.height);
+			c.height = 1 + std::max(a.height, g.height);
+		}
+		return c_index;
+	}
+
+	if (diff < -1) {
+		//rotate b up
+		Node & b = m_node_vec[b_index];
+		int d_index = b.child_1;
+		int e_index = b.child_2;
+
+		b.child_1 = a_index;
+		b.parent = a.parent;
+		a.parent = b_index;
+		if (b.parent != null_node) {
+			if (m_node_vec[b.parent].child_1 == a_index) {
+				m_node_vec[b.parent].child_1 = b_index;
+			}
+			else {
+				m_node_vec[b.parent].child_2 = b_index;
+			}
+		}
+		else {
+			m_root = b_index;
+		}
+
+		Node & c = m_node_vec[c_index];
+		Node & d = m_node_vec[d_index];
+		Node & e = m_node_vec[e_index];
+		if (d.height > e.height) {
+			b.child_2 = d_index;
+			a.child_1 = e_index;
+			e.parent = a_index;
+			a.rect = combine(c.rect, e.rect);
+			b.rect = combine(a.rect, d.rect);
+			a.height = 1 + std::max(c.height, e.height);
+			b.height = 1 + std::max(a.height, d.height);
+		}
+		else {
+			b.child_2 = e_index;
+			a.child_1 = d_index;
+			d.parent = a_index;
+			a.rect = combine(c.rect, d.rect);
+			b.rect = combine(a.rect, e.rect);
+			a.height = 1 + std::max(c.height, d.height);
+			b.height = 1 + std::max(a.height, e.height);
+		}
+		return b_index;
+	}
+
+	return a_index;
+}
+
+wykobi::rectangle<float> SpatialIndex::combine(const wykobi::rectangle<float> & a, const wykobi::rectangle<float> & b) {
+	return wykobi::make_rectangle<float>(
+		std::min(a[0].x, b[0].x),
+		std::min(a[0].y, b[0].y),
+		std::max(a[1].x, b[1].x),
+		std::max(a[1].y, b[1].y)
+	);
+}
+
+float SpatialIndex::perimeter(const wykobi::rectangle<float> & rect) {
+	return 2.f * ((rect[1].x - rect[0].x) + (rect[1].y - rect[0].y));
+}
+
+
+//end
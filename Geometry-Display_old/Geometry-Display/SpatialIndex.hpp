@@ -0,0 +1,134 @@
+//Author: Sivert Andresen Cubedo
+#pragma once
+
+#ifndef SpatialIndex_HEADER
+#define SpatialIndex_HEADER
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+#include <wykobi.hpp>
+
+namespace GeometryDisplay {
+	/*
+	Dynamic bounding volume hierarchy over axis aligned rectangles
+	Each rectangle is tagged with a user id
+	Insert and remove are O(log n), the tree is kept balanced with rotations
+	*/
+	class SpatialIndex {
+	public:
+		/*
+		Insert rectangle with id
+		Replaces rectangle if id is already in index
+		*/
+		void insert(std::size_t id, const wykobi::rectangle<float> & rect);
+
+		/*
+		Remove rectangle with id
+		Unknown ids are ignored
+		*/
+		void remove(std::size_t id);
+
+		/*
+		Remove all rectangles
+		*/
+		void clear();
+
+		/*
+		Number of rectangles
+		*/
+		std::size_t size() const;
+
+		/*
+		Get rectangle with id
+		return:
+			false if id is not in index
+		*/
+		bool getRectangle(std::size_t id, wykobi::rectangle<float> & out_rect) const;
+
+		/*
+		Get rectangle containing everything in index
+		return:
+			false if index is empty
+		*/
+		bool getBoundingRectangle(wykobi::rectangle<float> & out_rect) const;
+
+		/*
+		Append ids of rectangles intersecting rect
+		*/
+		void query(const wykobi::rectangle<float> & rect, std::vector<std::size_t> & out_vec) const;
+
+		/*
+		Call func(id) for each rectangle intersecting rect
+		Stops early if func returns false
+		*/
+		template <typename Func>
+		void query(const wykobi::rectangle<float> & rect, Func func) const {
+			if (m_root == null_node) {
+				return;
+			}
+			std::vector<int> stack;
+			stack.reserve(64);
+			stack.push_back(m_root);
+			while (!stack.empty()) {
+				int node_index = stack.back();
+				stack.pop_back();
+				const Node & node = m_node_vec[node_index];
+				if (!rectangleIntersect(node.rect, rect)) {
+					continue;
+				}
+				if (node.isLeaf()) {
+					if (!func(node.id)) {
+						return;
+					}
+				}
+				else {
+					stack.push_back(node.child_1);
+					stack.push_back(node.child_2);
+				}
+			}
+		}
+
+		/*
+		Make rectangle with [0] as low corner and [1] as high corner
+		*/
+		static wykobi::rectangle<float> normalizeRectangle(const wykobi::rectangle<float> & rect);
+
+		/*
+		Check if two normalized rectangles overlap, touching counts as overlap
+		*/
+		static bool rectangleIntersect(const wykobi::rectangle<float> & a, const wykobi::rectangle<float> & b);
+
+	private:
+		static const int null_node = -1;
+
+		struct Node {
+			wykobi::rectangle<float> rect;
+			int parent = null_node;
+			int child_1 = null_node;
+			int child_2 = null_node;
+			int height = 0;				//leaf = 0, free node = -1
+			std::size_t id = 0;
+			bool isLeaf() const { return child_1 == null_node; }
+		};
+
+		std::vector<Node> m_node_vec;
+		std::vector<int> m_free_vec;
+		std::unordered_map<std::size_t, int> m_leaf_map;
+		int m_root = null_node;
+
+		int allocateNode();
+		void freeNode(int node_index);
+		void insertLeaf(int leaf);
+		void removeLeaf(int leaf);
+		int balance(int a);
+		static wykobi::rectangle<float> combine(const wykobi::rectangle<float> & a, const wykobi::rectangle<float> & b);
+		static float perimeter(const wykobi::rectangle<float> & rect);
+	};
+}
+
+#endif // !SpatialIndex_HEADER
+
+
+//end
@@ -0,0 +1,161 @@
+//Author: Sivert Andresen Cubedo
+
+#include "StyleTable.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+using namespace GeometryDisplay;
+
+bool DrawStyle::operator==(const DrawStyle & other) const {
+	return inner_fill == other.inner_fill &&
+		outer_line == other.outer_line &&
+		fill_color == other.fill_color &&
+		line_color == other.line_color &&
+		outer_line_thickness == other.outer_line_thickness;
+}
+
+std::size_t DrawStyleHash::operator()(const DrawStyle & style) const {
+	std::uint32_t thickness_bits;
+	std::memcpy(&thickness_bits, &style.outer_line_thickness, sizeof(thickness_bits));
+	std::size_t h = std::hash<std::uint32_t>()(style.fill_color.toInteger());
+	h = h * 31 + std::hash<std::uint32_t>()(style.line_color.toInteger());
+	h = h * 31 + std::hash<std::uint32_t>()(thickness_bits);
+	h = h * 31 + (style.inner_fill ? 1 : 0) + (style.outer_line ? 2 : 0);
+	return h;
+}
+
+const std::size_t StyleTable::chunk_size;
+const std::size_t StyleTable::max_chunk_count;
+
+StyleTable::Table::Table() {
+	for (std::atomic<DrawStyle*> & chunk : chunk_arr) {
+		chunk.store(nullptr);
+	}
+	chunk_vec.emplace_back(new DrawStyle[chunk_size]);
+	chunk_arr[0].store(chunk_vec.back().get());
+	style_map.emplace(DrawStyle(), 0);
+	size.store(1);
+}
+
+StyleTable::Table & StyleTable::table() {
+	static Table t;
+	return t;
+}
+
+StyleId StyleTable::intern(const DrawStyle & style) {
+	Table & t = table();
+	std::unique_lock<std::mutex> m_lock(t.mutex);
+	auto it = t.style_map.find(style);
+	if (it != t.style_map.end()) {
+		return it->second;
+	}
+	std::size_t id = t.size.load(std::memory_order_relaxed);
+	if (id >= chunk_size * max_chunk_count) {
+		std::cout << "Error: StyleTable is full\n";
+		return 0;
+	}
+	if (id % chunk_size == 0) {
+		t.chunk_vec.emplace_back(new DrawStyle[chunk_size]);
+		t.chunk_arr[id / chunk_size].store(t.chunk_vec.back().get(), std::memory_order_release);
+	}
+	t.chunk_arr[id / chunk_size].load(std::memory_order_relaxed)[id % chunk_size] = style;
+	t.style_map.emplace(style, static_cast<StyleId>(id));
+	//entry is written before size makes it visible
+	t.size.store(id + 1, std::memory_order_release);
+	return static_cast<StyleId>(id);
+}
+
+DrawStyle StyleTable::get(StyleId id) {
+	Table & t = table();
+	if (id >= t.size.load(std::memory_order_acquire)) {
+		return DrawStyle();
+	}
+	return t.chunk_arr[id / chunk_size].load(std::memory_order_acquire)[id % chunk_size];
+}
+
+std::size_t StyleTable::size() {
+	return table().size.load(std::memory_order_acquire);
+}
+
+StyleId StyleClassMap::resolve(StyleId class_id) const {
+	if (m_style_map.empty()) {
+		return class_id;
+	}
+	auto it = m_style_map.find(class_id);
+	return (it != m_style_map.end()) ? it->second : class_id;
+}
+
+DrawStyle StyleClassMap::get(StyleId class_id) const {
+	return StyleTable::get(resolve(class_id));
+}
+
+void StyleClassMap::set(StyleId class_id, StyleId style_id) {
+	if (class_id == style_id) {
+		m_style_map.erase(class_id);
+	}
+	else {
+		m_style_map[class_id] = style_id;
+	}
+}
+
+bool StyleClassMap::isRestyled(StyleId class_id) const {
+	return m_style_map.find(class_id) != m_style_map.end();
+}
+
+void StyleClassMap::appendChanged(const StyleClassMap & other, std::vector<StyleId> & out_vec) const {
+	std::size_t begin = out_vec.size();
+	for (const std::pair<const StyleId, StyleId> & entry : m_style_map) {
+		if (other.resolve(entry.first) != entry.second) {
+			out_vec.push_back(entry.first);
+		}
+	}
+	for (const std::pair<const StyleId, StyleId> & entry : other.m_style_map) {
+		if (!isRestyled(entry.first)) {
+			out_vec.push_back(entry.first);
+		}
+	}
+	std::sort(out_vec.begin() + begin, out_vec.end());
+}
+
+NamePool::Pool & NamePool::pool() {
+	static Pool p;
+	return p;
+}
+
+NameId NamePool::intern(const std::string & name) {
+	Pool & p = pool();
+	std::unique_lock<std::mutex> m_lock(p.mutex);
+	if (p.name_deque.empty()) {
+		p.name_deque.push_back(std::string());
+		p.name_map.emplace(std::string(), 0);
+	}
+	auto it = p.name_map.find(name);
+	if (it != p.name_map.end()) {
+		return it->second;
+	}
+	NameId id = static_cast<NameId>(p.name_deque.size());
+	p.name_deque.push_back(name);
+	p.name_map.emplace(name, id);
+	return id;
+}
+
+const std::string & NamePool::get(NameId id) {
+	static const std::string empty_name;
+	Pool & p = pool();
+	std::unique_lock<std::mutex> m_lock(p.mutex);
+	if (id < p.name_deque.size()) {
+		return p.name_deque[id];
+	}
+	return empty_name;
+}
+
+std::size_t NamePool::size() {
+	Pool & p = pool();
+	std::unique_lock<std::mutex> m_lock(p.mutex);
+	return p.name_deque.size();
+}
+
+
+//end
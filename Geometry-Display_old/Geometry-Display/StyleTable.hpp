@@ -0,0 +1,149 @@
+//Author: Sivert Andresen Cubedo
+#pragma once
+
+#ifndef StyleTable_HEADER
+#define StyleTable_HEADER
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <array>
+#include <memory>
+#include <cstdint>
+
+#include <SFML\Graphics.hpp>
+
+namespace GeometryDisplay {
+	typedef std::uint32_t StyleId;
+	typedef std::uint32_t NameId;
+
+	/*
+	Colors and flags used when tessellating a DrawObject
+	*/
+	struct DrawStyle {
+		bool inner_fill = true;
+		bool outer_line = false;
+		sf::Color fill_color;
+		sf::Color line_color;
+		float outer_line_thickness = 2.f;
+
+		bool operator==(const DrawStyle & other) const;
+	};
+
+	struct DrawStyleHash {
+		std::size_t operator()(const DrawStyle & style) const;
+	};
+
+	/*
+	Process wide table of interned DrawStyle
+	Entries never change once added, so any shape with the same style can share an id
+	Id 0 is always DrawStyle()
+	*/
+	class StyleTable {
+	public:
+		/*
+		Get id of style, adding it if it is new
+		*/
+		static StyleId intern(const DrawStyle & style);
+
+		/*
+		Get style with id
+		Never locks, safe to call from any number of threads
+		*/
+		static DrawStyle get(StyleId id);
+
+		/*
+		Number of interned styles
+		*/
+		static std::size_t size();
+	private:
+		//entries live in fixed chunks that are never moved, so readers need no lock
+		static const std::size_t chunk_size = 4096;
+		static const std::size_t max_chunk_count = 16384;
+
+		struct Table {
+			std::mutex mutex;				//taken by intern only
+			std::array<std::atomic<DrawStyle*>, max_chunk_count> chunk_arr;
+			std::vector<std::unique_ptr<DrawStyle[]>> chunk_vec;	//owns chunk_arr
+			std::atomic<std::size_t> size{ 0 };
+			std::unordered_map<DrawStyle, StyleId, DrawStyleHash> style_map;
+			Table();
+		};
+		static Table & table();
+	};
+
+	/*
+	Style drawn for each style class of one Window
+	Shapes keep their class in style_id, a class is drawn with its own StyleTable entry until it is restyled
+	Shared read only between threads once published, restyling makes a changed copy, so copies are O(restyled classes)
+	*/
+	class StyleClassMap {
+	public:
+		/*
+		Get StyleTable id drawn for class_id
+		*/
+		StyleId resolve(StyleId class_id) const;
+
+		/*
+		Get style drawn for class_id
+		*/
+		DrawStyle get(StyleId class_id) const;
+
+		/*
+		Draw class_id with StyleTable id style_id
+		*/
+		void set(StyleId class_id, StyleId style_id);
+
+		/*
+		Check if class_id is drawn with another entry than its own
+		*/
+		bool isRestyled(StyleId class_id) const;
+
+		/*
+		Get classes drawn differently by this and other, sorted
+		O(restyled classes of both)
+		*/
+		void appendChanged(const StyleClassMap & other, std::vector<StyleId> & out_vec) const;
+
+	private:
+		std::unordered_map<StyleId, StyleId> m_style_map;		//restyled classes only
+	};
+
+	/*
+	Process wide pool of interned strings
+	Id 0 is always the empty string
+	*/
+	class NamePool {
+	public:
+		/*
+		Get id of name, adding it if it is new
+		*/
+		static NameId intern(const std::string & name);
+
+		/*
+		Get name with id
+		Reference stays valid for the lifetime of the program
+		*/
+		static const std::string & get(NameId id);
+
+		/*
+		Number of interned names
+		*/
+		static std::size_t size();
+	private:
+		struct Pool {
+			std::mutex mutex;
+			std::deque<std::string> name_deque;		//deque never moves elements on push_back
+			std::unordered_map<std::string, NameId> name_map;
+		};
+		static Pool & pool();
+	};
+}
+
+#endif // !StyleTable_HEADER
+
+
+//end
@@ -8,6 +8,9 @@
 #include <mutex>
 #include <chrono>
 #include <memory>
+#include <vector>
+#include <limits>
+#include <stdexcept>
 
 #include <SFML\Graphics.hpp>
 #include <wykobi.hpp>
@@ -16,7 +19,104 @@
 
 #include "FileDialog.hpp"
 
-int main() {
+/*
+Parse whole string as unsigned number
+return:
+	false if str is not a number or does not fit in out
+*/
+bool parseUnsigned(std::string str, unsigned int & out) {
+	std::size_t end = 0;
+	unsigned long value = 0;
+	try {
+		value = std::stoul(str, &end);
+	}
+	catch (const std::exception &) {
+		return false;
+	}
+	if (end != str.size() || str.find('-') != std::string::npos || value > std::numeric_limits<unsigned int>::max()) {
+		return false;
+	}
+	out = static_cast<unsigned int>(value);
+	return true;
+}
+
+/*
+Render shape files to png or svg without opening a window
+args:
+	--render <width> <height> <out_dir> <file>...
+	--svg <width> <height> <out_dir> <file>...
+*/
+int renderBatch(int argc, char** argv) {
+	if (argc < 6) {
+		std::cout << "Usage: " << argv[1] << " <width> <height> <out_dir> <file>...\n";
+		return EXIT_FAILURE;
+	}
+	sf::Vector2u size;
+	if (!parseUnsigned(argv[2], size.x) || !parseUnsigned(argv[3], size.y) || size.x == 0 || size.y == 0) {
+		std::cout << "Invalid size: " << argv[2] << " " << argv[3] << "\n";
+		return EXIT_FAILURE;
+	}
+	std::string out_dir = argv[4];
+	bool svg = std::string(argv[1]) == "--svg";
+	int result = EXIT_SUCCESS;
+	for (int i = 5; i < argc; ++i) {
+		std::string path = argv[i];
+		std::size_t name_begin = path.find_last_of("/\\");
+		name_begin = (name_begin == std::string::npos) ? 0 : name_begin + 1;
+		std::string name = path.substr(name_begin, path.find_last_of('.') - name_begin);
+		std::string image_path = out_dir + "/" + name + (svg ? ".svg" : ".png");
+		bool written = svg ?
+			GeometryDisplay::renderShapeFileToSvg(path, image_path, size, wykobi::make_rectangle(0.f, 0.f, 0.f, 0.f)) :
+			GeometryDisplay::renderShapeFileToImage(path, image_path, size, wykobi::make_rectangle(0.f, 0.f, 0.f, 0.f));
+		if (!written) {
+			result = EXIT_FAILURE;
+		}
+		else {
+			std::cout << path << " -> " << image_path << "\n";
+		}
+	}
+	return result;
+}
+
+/*
+Export shape file as deep zoom tile pyramid without opening a window
+args:
+	--tiles <tile_size> <max_level> <out_dir> <file>
+*/
+int exportTiles(int argc, char** argv) {
+	if (argc < 6) {
+		std::cout << "Usage: --tiles <tile_size> <max_level> <out_dir> <file>\n";
+		return EXIT_FAILURE;
+	}
+	unsigned int tile_size = 0;
+	if (!parseUnsigned(argv[2], tile_size) || tile_size == 0) {
+		std::cout << "Invalid tile size: " << argv[2] << "\n";
+		return EXIT_FAILURE;
+	}
+	unsigned int max_level = 0;
+	if (!parseUnsigned(argv[3], max_level) || max_level > GeometryDisplay::max_tile_pyramid_level) {
+		std::cout << "Invalid max level: " << argv[3] << "\n";
+		return EXIT_FAILURE;
+	}
+	std::vector<std::shared_ptr<const GeometryDisplay::DrawObject>> shape_vec;
+	if (!GeometryDisplay::parseShapeFile(argv[5], false, shape_vec)) {
+		return EXIT_FAILURE;
+	}
+	wykobi::rectangle<float> world_rect = GeometryDisplay::fitWorldRectangle(shape_vec, sf::Vector2u(1, 1));
+	if (!GeometryDisplay::exportTilePyramid(argv[4], shape_vec, world_rect, tile_size, max_level, sf::Color::Transparent)) {
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && (std::string(argv[1]) == "--render" || std::string(argv[1]) == "--svg")) {
+		return renderBatch(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--tiles") {
+		return exportTiles(argc, argv);
+	}
+
 	std::shared_ptr<sf::Font> arial(new sf::Font());
 	if (!arial->loadFromFile("fonts/arial.ttf")) {
 		std::cout << "Font load failed\n";
@@ -33,18 +133,18 @@ int main() {
 	//w.addShape(line);
 	//
 	//GeometryDisplay::PolygonShape p1(wykobi::make_polygon(wykobi::make_circle(100.f, 100.f, 50.f), 100));
-	//p1.name = "P1";
-	//p1.inner_fill = true;
-	//p1.outer_line = true;
-	//p1.fill_color = sf::Color::Green;
-	//p1.line_color = sf::Color::Cyan;
+	//p1.setName("P1");
+	//p1.setInnerFill(true);
+	//p1.setOuterLine(true);
+	//p1.setFillColor(sf::Color::Green);
+	//p1.setLineColor(sf::Color::Cyan);
 	//
 	//GeometryDisplay::PolygonShape p2(wykobi::make_polygon(wykobi::make_circle(100.f, -500.f, 50.f), 100));
-	//p2.name = "P2";
-	//p2.inner_fill = true;
-	//p2.outer_line = true;
-	//p2.fill_color = sf::Color::Green;
-	//p2.line_color = sf::Color::Cyan;
+	//p2.setName("P2");
+	//p2.setInnerFill(true);
+	//p2.setOuterLine(true);
+	//p2.setFillColor(sf::Color::Green);
+	//p2.setLineColor(sf::Color::Cyan);
 	//
 	//w.addShape(p1);
 	//w.addShape(p2);